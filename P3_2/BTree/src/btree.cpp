@@ -46,6 +46,7 @@ namespace badgerdb {
         // loading file
         try {
             file = new BlobFile(outIndexName, false);
+            bufMgr->setFileClass(file, INDEX_CLASS);
             // read metadata
             Page *headerPage;
             headerPageNum = file->getFirstPageNo();
@@ -60,6 +61,7 @@ namespace badgerdb {
         } catch(FileNotFoundException e) { // if blob file does not exist
             // create a new blob file
             file = new BlobFile(outIndexName, true);
+            bufMgr->setFileClass(file, INDEX_CLASS);
             //allocate header and root page
             Page *rootPage;
             Page *headerPage;
@@ -107,6 +109,7 @@ namespace badgerdb {
     {
       scanExecuting = false;
       bufMgr->flushFile(BTreeIndex::file);
+      bufMgr->setFileClass(file, HEAP_CLASS);
       delete file;
       file = nullptr;
     }
@@ -152,6 +155,7 @@ namespace badgerdb {
         if (scanExecuting)
             endScan();
         // init scanning
+        prefetchCursor = Page::INVALID_NUMBER;
         currentPageNum = rootPageNum;
         bufMgr->readPage(file, currentPageNum, currentPageData);
         if (initRootPageNo != rootPageNum) { // if root not a leaf
@@ -197,6 +201,7 @@ namespace badgerdb {
                         targetFound = true;
                         nextEntry = i;
                         scanExecuting = true;
+                        readAheadSiblings(curNode);
                         break;
                     } else if((highOp == LT && curKey >= highValInt) || ((highOp == LTE) && curKey > highValInt)) {
                         // if no matching key is in range
@@ -243,6 +248,7 @@ namespace badgerdb {
                 bufMgr->readPage(file, currentPageNum, currentPageData);
                 curNode = (LeafNodeInt *) currentPageData;
                 nextEntry = 0; // reset
+                readAheadSiblings(curNode);
             }
         }
         // check for un-scanned keys in current leaf, if any
@@ -527,4 +533,14 @@ namespace badgerdb {
             return key < highVal && key > lowVal;
         }
     }
+
+    /**
+     * Helper function that asks the buffer manager to read the leaves to the right of the given
+     * leaf in the background, so that a range scan does not wait for each of them.
+     * @param leafNode leaf the scan is on
+     */
+    void BTreeIndex::readAheadSiblings(LeafNodeInt *leafNode) {
+        bufMgr->readAheadFrom(file, currentPageNum, leafNode->rightSibPageNo, prefetchCursor,
+                              [](const Page& page) { return ((const LeafNodeInt *) &page)->rightSibPageNo; });
+    }
 }
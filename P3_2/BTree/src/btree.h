@@ -11,6 +11,7 @@
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <atomic>
 
 #include "types.h"
 #include "page.h"
@@ -251,6 +252,11 @@ class BTreeIndex {
    */
 	Page		*currentPageData;
 
+  /**
+   * Last leaf the scan has asked to be read ahead.
+   */
+	std::atomic<PageId>	prefetchCursor;
+
   /**
    * Low INTEGER value for scan.
    */
@@ -367,6 +373,13 @@ class BTreeIndex {
     */
     const bool keyIsInRange(int lowVal, const Operator LOP, int highVal, const Operator GOP, int key);
 
+    /**
+    * Helper function that asks the buffer manager to read the leaves to the right of the given
+    * leaf in the background, so that a range scan does not wait for each of them.
+    * @param leafNode leaf the scan is on
+    */
+    void readAheadSiblings(LeafNodeInt *leafNode);
+
 public:
 
   /**
@@ -7,108 +7,158 @@
 
 #include <memory>
 #include <iostream>
+#include <cstring>
 #include "buffer.h"
 #include "bufHashTbl.h"
 #include "exceptions/hash_already_present_exception.h"
-#include "exceptions/hash_not_found_exception.h"
-#include "exceptions/hash_table_exception.h"
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+std::uint64_t BufHashTbl::hash(const File* file, const PageId pageNo)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  // mix the pointer and page number (splitmix64 finalizer) so that pages of
+  // the same file spread over all partitions and slots
+  std::uint64_t value = (std::uint64_t) (std::uintptr_t) file;
+  value ^= ((std::uint64_t) pageNo << 32) | pageNo;
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31);
 }
 
-BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
+std::uint32_t BufHashTbl::capacityFor(const int htSize, const int partitions)
 {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
-  for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+  // size every partition for twice its share of the entries
+  std::uint32_t capacity = 8;
+  while (capacity < (std::uint32_t) (2 * htSize / partitions))
+    capacity <<= 1;
+  return capacity;
+}
+
+BufHashTbl::BufHashTbl(int htSize, int partitions)
+	: numPartitions(partitions)
+{
+  const std::uint32_t capacity = capacityFor(htSize, partitions);
+
+  parts = new Partition[partitions];
+  for(int i = 0; i < numPartitions; i++) {
+    parts[i].slots = new hashSlot[capacity];
+    memset(parts[i].slots, 0, capacity * sizeof(hashSlot));
+    parts[i].capacity = capacity;
+    parts[i].count = 0;
+  }
 }
 
 BufHashTbl::~BufHashTbl()
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
+  for(int i = 0; i < numPartitions; i++)
+    delete [] parts[i].slots;
+  delete [] parts;
+}
+
+std::uint32_t BufHashTbl::probe(const Partition& part, const std::uint64_t h,
+                                const File* file, const PageId pageNo)
+{
+  const std::uint32_t mask = part.capacity - 1;
+  std::uint32_t index = (std::uint32_t) h & mask;
+  while (part.slots[index].file != NULL &&
+         (part.slots[index].file != file || part.slots[index].pageNo != pageNo))
+    index = (index + 1) & mask;
+  return index;
+}
+
+void BufHashTbl::rehash(Partition& part, const std::uint32_t capacity)
+{
+  hashSlot* old = part.slots;
+  const std::uint32_t oldCapacity = part.capacity;
+
+  part.capacity = capacity;
+  part.slots = new hashSlot[part.capacity];
+  memset(part.slots, 0, part.capacity * sizeof(hashSlot));
+
+  for (std::uint32_t i = 0; i < oldCapacity; i++) {
+    if (old[i].file != NULL) {
+      const std::uint64_t h = hash(old[i].file, old[i].pageNo);
+      part.slots[probe(part, h, old[i].file, old[i].pageNo)] = old[i];
     }
   }
-  delete [] ht;
+  delete [] old;
 }
 
 void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
+  const std::uint64_t h = hash(file, pageNo);
+  Partition& part = parts[(h >> 32) % numPartitions];
 
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
-  }
+  std::uint32_t index = probe(part, h, file, pageNo);
+  if (part.slots[index].file != NULL)
+  	throw HashAlreadyPresentException(part.slots[index].file->filename(), pageNo, part.slots[index].frameNo);
 
-  tmpBuc = new hashBucket;
-  if (!tmpBuc)
-  	throw HashTableException();
+  // keep the load factor at or below 3/4 so probe sequences stay short
+  if ((part.count + 1) * 4 > part.capacity * 3) {
+    rehash(part, part.capacity * 2);
+    index = probe(part, h, file, pageNo);
+  }
 
-  tmpBuc->file = (File*) file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  part.slots[index].file = (File*) file;
+  part.slots[index].pageNo = pageNo;
+  part.slots[index].frameNo = frameNo;
+  part.count++;
 }
 
-void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+bool BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) const
 {
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-    {
-      frameNo = tmpBuc->frameNo; // return frameNo by reference
-      return;
-    }
-    tmpBuc = tmpBuc->next;
-  }
+  const std::uint64_t h = hash(file, pageNo);
+  const Partition& part = parts[(h >> 32) % numPartitions];
 
-  throw HashNotFoundException(file->filename(), pageNo);
-}
+  const hashSlot& slot = part.slots[probe(part, h, file, pageNo)];
+  if (slot.file == NULL)
+    return false;
 
-void BufHashTbl::remove(const File* file, const PageId pageNo) {
+  frameNo = slot.frameNo; // return frameNo by reference
+  return true;
+}
 
-  int index = hash(file, pageNo);
-  hashBucket* tmpBuc = ht[index];
-  hashBucket* prevBuc = NULL;
+void BufHashTbl::resize(const int partition, const int htSize)
+{
+  Partition& part = parts[partition];
+  std::uint32_t capacity = capacityFor(htSize, numPartitions);
+  while ((part.count + 1) * 4 > capacity * 3)
+    capacity <<= 1;
 
-  while (tmpBuc)
-	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-		{
-      if(prevBuc) 
-				prevBuc->next = tmpBuc->next;
-      else
-				ht[index] = tmpBuc->next;
+  if (capacity != part.capacity)
+    rehash(part, capacity);
+}
 
-      delete tmpBuc;
-      return;
-    }
-		else
-		{
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
+bool BufHashTbl::remove(const File* file, const PageId pageNo) {
+  const std::uint64_t h = hash(file, pageNo);
+  Partition& part = parts[(h >> 32) % numPartitions];
+  const std::uint32_t mask = part.capacity - 1;
+
+  std::uint32_t hole = probe(part, h, file, pageNo);
+  if (part.slots[hole].file == NULL)
+    return false;
+
+  // backward shift deletion: move later entries of the cluster into the hole
+  // if that brings them closer to their home slot, so no tombstones are needed
+  std::uint32_t index = hole;
+  while (true) {
+    index = (index + 1) & mask;
+    if (part.slots[index].file == NULL)
+      break;
+
+    const std::uint32_t home =
+        (std::uint32_t) hash(part.slots[index].file, part.slots[index].pageNo) & mask;
+    // entry stays put if its home lies cyclically in (hole, index]
+    if (((index - home) & mask) >= ((index - hole) & mask)) {
+      part.slots[hole] = part.slots[index];
+      hole = index;
     }
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  part.slots[hole].file = NULL;
+  part.count--;
+  return true;
 }
 
 }
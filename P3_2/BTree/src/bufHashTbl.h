@@ -14,9 +14,9 @@ namespace badgerdb {
 /**
 * @brief Declarations for buffer pool hash table
 */
-struct hashBucket {
+struct hashSlot {
 	/**
-	 * pointer a file object (more on this below)
+	 * pointer a file object (more on this below); NULL if the slot is empty
 	 */
 	File *file;
 
@@ -29,50 +29,117 @@ struct hashBucket {
 	 * frame number of page in the buffer pool
 	 */
 	FrameId frameNo;
-
-	/**
-	 * Next node in the hash table
-	 */
-	hashBucket*   next;
 };
 
 
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
-* @warning This class is not threadsafe.
+* The table is split into partitions, each a flat array of slots probed
+* linearly.  The high bits of the hash select the partition and the low bits
+* the home slot, so entries of different partitions never share memory and
+* operations on different partitions may run concurrently.  Each partition
+* doubles its slot array when it becomes three quarters full, so a partition
+* that receives more than its share of pages never fills up.
+*
+* @warning This class is not threadsafe; callers must serialize operations
+*          within a partition.
 */
 class BufHashTbl
 {
  private:
 	/**
-	 *	Size of Hash Table
+	 * @brief One independently sized open-addressing table
+	 */
+  struct Partition {
+		/**
+		 * Slot array, capacity is a power of two
+		 */
+    hashSlot* slots;
+
+		/**
+		 * Number of slots in the array
+		 */
+    std::uint32_t capacity;
+
+		/**
+		 * Number of slots in use
+		 */
+    std::uint32_t count;
+  };
+
+	/**
+	 *	Number of partitions
 	 */
-  int HTSIZE;
+  int numPartitions;
+
 	/**
-	 * Actual Hash table object
+	 * Actual Hash table partitions
 	 */
-  hashBucket**  ht;
+  Partition* parts;
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * returns 64 bit hash value computed using file and pageNo
 	 *
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  static std::uint64_t hash(const File* file, const PageId pageNo);
+
+	/**
+	 * Returns the index of the slot holding (file, pageNo), or of the empty slot ending its probe sequence.
+	 *
+	 * @param part   	Partition to search
+	 * @param h       Hash value of the entry
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return  			Slot index.
+	 */
+  static std::uint32_t probe(const Partition& part, const std::uint64_t h,
+                             const File* file, const PageId pageNo);
+
+	/**
+	 * Returns the slot array size each partition starts with for a table expected to hold htSize entries.
+	 *
+	 * @param htSize      Number of entries the table is expected to hold
+	 * @param partitions  Number of partitions
+	 */
+  static std::uint32_t capacityFor(const int htSize, const int partitions);
+
+	/**
+	 * Replaces the slot array of a partition by one of the given size and reinserts its entries.
+	 *
+	 * @param part   	Partition to rehash
+	 * @param capacity	New number of slots, a power of two
+	 */
+  static void rehash(Partition& part, const std::uint32_t capacity);
 
  public:
 	/**
    * Constructor of BufHashTbl class
+	 *
+	 * @param htSize      Number of entries the table is expected to hold
+	 * @param partitions  Number of partitions
 	 */
-	BufHashTbl(const int htSize);  // constructor
+	BufHashTbl(const int htSize, const int partitions);  // constructor
 
 	/**
    * Destructor of BufHashTbl class
 	 */
   ~BufHashTbl(); // destructor
+
+	/**
+   * Returns the partition the entry for (file, pageNo) belongs to.
+	 *
+	 * @param file   	File object
+	 * @param pageNo 	Page number in the file
+	 * @return  			Partition number between 0 and the number of partitions - 1.
+	 */
+  int partition(const File* file, const PageId pageNo) const
+  {
+		return (int) ((hash(file, pageNo) >> 32) % numPartitions);
+  }
 	
 	/**
    * Insert entry into hash table mapping (file, pageNo) to frameNo.
@@ -81,7 +148,6 @@ class BufHashTbl
 	 * @param pageNo 	Page number in the file
 	 * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
-   * @throws  HashTableException (optional) if could not create a new bucket as running of memory
 	 */
   void insert(const File* file, const PageId pageNo, const FrameId frameNo);
 
@@ -91,19 +157,28 @@ class BufHashTbl
 	 *
 	 * @param file  	File object
 	 * @param pageNo	Page number in the file
-	 * @param frameNo Frame number reference
-   * @throws HashNotFoundException if the page entry is not found in the hash table 
+	 * @param frameNo Frame number reference, set if the page is found
+	 * @return  			True if the page entry was found in the hash table.
 	 */
-  void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
+  bool lookup(const File* file, const PageId pageNo, FrameId &frameNo) const;
 
 	/**
    * Delete entry (file,pageNo) from hash table.
 	 *
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
-   * @throws HashNotFoundException if the page entry is not found in the hash table 
+	 * @return  			True if the page entry was found and removed.
+	 */
+  bool remove(const File* file, const PageId pageNo);  
+
+	/**
+   * Resizes a partition for a table expected to hold htSize entries, e.g. after the buffer pool
+   * was resized.  A partition never shrinks below what its current entries need.
+	 *
+	 * @param partition	Partition to resize
+	 * @param htSize    Number of entries the table is expected to hold
 	 */
-  void remove(const File* file, const PageId pageNo);  
+  void resize(const int partition, const int htSize);
 };
 
 }
@@ -0,0 +1,148 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "buf_stats.h"
+
+namespace badgerdb {
+
+void LatencyHistogram::record(const std::uint64_t micros)
+{
+  std::uint32_t bucket = 0;
+  while (bucket < NUM_BUCKETS - 1 && micros >= ((std::uint64_t) 1 << bucket))
+    bucket++;
+
+  buckets[bucket]++;
+  count++;
+  totalMicros += micros;
+}
+
+std::uint64_t LatencyHistogram::percentile(const double fraction) const
+{
+  std::uint64_t n = 0;
+  for (std::uint32_t i = 0; i < NUM_BUCKETS; i++)
+    n += buckets[i];
+  if (n == 0)
+    return 0;
+
+  const std::uint64_t rank = (std::uint64_t) (fraction * n);
+  std::uint64_t seen = 0;
+  for (std::uint32_t i = 0; i < NUM_BUCKETS; i++)
+  {
+    seen += buckets[i];
+    if (seen > rank || seen == n)
+      return (std::uint64_t) 1 << i;
+  }
+  return (std::uint64_t) 1 << (NUM_BUCKETS - 1);
+}
+
+void LatencyHistogram::clear()
+{
+  for (std::uint32_t i = 0; i < NUM_BUCKETS; i++)
+    buckets[i] = 0;
+  count = 0;
+  totalMicros = 0;
+}
+
+LatencyHistogram& LatencyHistogram::operator=(const LatencyHistogram& other)
+{
+  for (std::uint32_t i = 0; i < NUM_BUCKETS; i++)
+    buckets[i] = other.buckets[i].load();
+  count = other.count.load();
+  totalMicros = other.totalMicros.load();
+  return *this;
+}
+
+void BufStats::clear()
+{
+  accesses = diskreads = diskwrites = 0;
+  hits = misses = prefetches = victimCacheHits = 0;
+  evictions = dirtyEvictions = writerWrites = 0;
+  pinWaits = allocWaits = allocTimeouts = 0;
+  commits = logFlushes = 0;
+  checkpoints = checkpointWrites = 0;
+  allocWaitTime.clear();
+  readLatency.clear();
+  writeLatency.clear();
+}
+
+BufStats& BufStats::operator=(const BufStats& other)
+{
+  accesses = other.accesses.load();
+  diskreads = other.diskreads.load();
+  diskwrites = other.diskwrites.load();
+  hits = other.hits.load();
+  misses = other.misses.load();
+  prefetches = other.prefetches.load();
+  victimCacheHits = other.victimCacheHits.load();
+  evictions = other.evictions.load();
+  dirtyEvictions = other.dirtyEvictions.load();
+  writerWrites = other.writerWrites.load();
+  pinWaits = other.pinWaits.load();
+  allocWaits = other.allocWaits.load();
+  allocTimeouts = other.allocTimeouts.load();
+  commits = other.commits.load();
+  logFlushes = other.logFlushes.load();
+  checkpoints = other.checkpoints.load();
+  checkpointWrites = other.checkpointWrites.load();
+  allocWaitTime = other.allocWaitTime;
+  readLatency = other.readLatency;
+  writeLatency = other.writeLatency;
+  return *this;
+}
+
+namespace {
+
+void dumpHistogram(std::ostream& out, const std::string& name, const LatencyHistogram& histogram)
+{
+  out << name << "_count " << histogram.count << "\n";
+  out << name << "_mean_us " << histogram.mean() << "\n";
+  out << name << "_p50_us " << histogram.percentile(0.5) << "\n";
+  out << name << "_p99_us " << histogram.percentile(0.99) << "\n";
+  for (std::uint32_t i = 0; i < LatencyHistogram::NUM_BUCKETS; i++)
+  {
+    if (histogram.buckets[i] != 0)
+      out << name << "_bucket_lt_" << ((std::uint64_t) 1 << i) << "us " << histogram.buckets[i] << "\n";
+  }
+}
+
+}
+
+void BufStatsSnapshot::dump(std::ostream& out) const
+{
+  out << "policy " << policy << "\n";
+  out << "pool_size " << poolSize << "\n";
+  out << "accesses " << totals.accesses << "\n";
+  out << "hits " << totals.hits << "\n";
+  out << "misses " << totals.misses << "\n";
+  out << "hit_ratio " << totals.hitRatio() << "\n";
+  out << "prefetches " << totals.prefetches << "\n";
+  out << "victim_cache_hits " << totals.victimCacheHits << "\n";
+  out << "victim_cache_bytes " << victimCacheBytes << "\n";
+  out << "disk_reads " << totals.diskreads << "\n";
+  out << "disk_writes " << totals.diskwrites << "\n";
+  out << "evictions " << totals.evictions << "\n";
+  out << "dirty_evictions " << totals.dirtyEvictions << "\n";
+  out << "writer_writes " << totals.writerWrites << "\n";
+  out << "pin_waits " << totals.pinWaits << "\n";
+  out << "alloc_waits " << totals.allocWaits << "\n";
+  out << "alloc_timeouts " << totals.allocTimeouts << "\n";
+  out << "commits " << totals.commits << "\n";
+  out << "log_flushes " << totals.logFlushes << "\n";
+  out << "checkpoints " << totals.checkpoints << "\n";
+  out << "checkpoint_writes " << totals.checkpointWrites << "\n";
+  dumpHistogram(out, "read_latency", totals.readLatency);
+  dumpHistogram(out, "write_latency", totals.writeLatency);
+  dumpHistogram(out, "alloc_wait", totals.allocWaitTime);
+
+  for (std::map<std::string, FileStats>::const_iterator it = files.begin(); it != files.end(); ++it)
+  {
+    out << "file " << it->first << " hits " << it->second.hits << " misses " << it->second.misses
+        << " prefetches " << it->second.prefetches << " writes " << it->second.writes << "\n";
+  }
+}
+
+}
@@ -0,0 +1,338 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+
+namespace badgerdb {
+
+/**
+ * @brief Histogram of operation latencies in power of two buckets of microseconds.
+ *
+ * Bucket 0 counts operations taking less than a microsecond, bucket i > 0
+ * those taking at least 2^(i-1) and less than 2^i microseconds; the last
+ * bucket also takes everything slower.  Recording is lock free.
+ */
+struct LatencyHistogram
+{
+	/**
+   * Number of buckets
+	 */
+  static const std::uint32_t NUM_BUCKETS = 32;
+
+	/**
+   * Clock latencies are measured with
+	 */
+  typedef std::chrono::steady_clock Clock;
+
+	/**
+   * Number of operations per bucket
+	 */
+  std::atomic<std::uint64_t> buckets[NUM_BUCKETS];
+
+	/**
+   * Number of operations recorded
+	 */
+  std::atomic<std::uint64_t> count;
+
+	/**
+   * Sum of the latencies recorded, in microseconds
+	 */
+  std::atomic<std::uint64_t> totalMicros;
+
+	/**
+	 * Records an operation taking the given time.
+	 *
+	 * @param micros	Latency in microseconds
+	 */
+  void record(const std::uint64_t micros);
+
+	/**
+	 * Records an operation which started at the given time and has just completed.
+	 *
+	 * @param start	Time the operation started
+	 */
+  void record(const Clock::time_point start)
+  {
+		record(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+  }
+
+	/**
+	 * Returns the latency below which the given fraction of operations completed, as the upper bound of the
+	 * bucket it falls in, in microseconds.  Returns 0 if nothing was recorded.
+	 *
+	 * @param fraction	Fraction of operations, between 0 and 1
+	 */
+  std::uint64_t percentile(const double fraction) const;
+
+	/**
+   * Returns the mean latency in microseconds, 0 if nothing was recorded
+	 */
+  double mean() const
+  {
+		const std::uint64_t n = count;
+		return n == 0 ? 0.0 : (double) totalMicros / n;
+  }
+
+	/**
+   * Clear all values
+	 */
+  void clear();
+
+	/**
+   * Constructor of LatencyHistogram class
+	 */
+  LatencyHistogram()
+  {
+		clear();
+  }
+
+	/**
+   * Copies the current values of another histogram
+	 */
+  LatencyHistogram(const LatencyHistogram& other)
+  {
+		*this = other;
+  }
+
+  LatencyHistogram& operator=(const LatencyHistogram& other);
+};
+
+
+/**
+* @brief Buffer pool usage of one file
+*/
+struct FileStats
+{
+	/**
+   * Requests for pages of the file found in the pool
+	 */
+  std::uint64_t hits;
+
+	/**
+   * Requests for pages of the file which had to be read from disk
+	 */
+  std::uint64_t misses;
+
+	/**
+   * Pages of the file read ahead by the prefetch thread
+	 */
+  std::uint64_t prefetches;
+
+	/**
+   * Pages of the file written back to disk
+	 */
+  std::uint64_t writes;
+
+	/**
+   * Constructor of FileStats class
+	 */
+  FileStats()
+		: hits(0), misses(0), prefetches(0), writes(0)
+  {
+  }
+
+	/**
+   * Adds the counts of another FileStats
+	 */
+  FileStats& operator+=(const FileStats& other)
+  {
+		hits += other.hits;
+		misses += other.misses;
+		prefetches += other.prefetches;
+		writes += other.writes;
+		return *this;
+  }
+};
+
+
+/**
+* @brief Class to maintain statistics of buffer usage
+*
+* Counters are atomic, so the threads sharing a BufMgr update them without a
+* lock.  Copying a BufStats takes the current value of every counter; the
+* copy is not a consistent cut while the pool is in use.
+*/
+struct BufStats
+{
+	/**
+   * Total number of accesses to buffer pool
+	 */
+  std::atomic<int> accesses;
+
+	/**
+   * Number of pages read from disk (including allocs)
+	 */
+  std::atomic<int> diskreads;
+
+	/**
+   * Number of pages written back to disk
+	 */
+  std::atomic<int> diskwrites;
+
+	/**
+   * Number of requested pages found in the pool
+	 */
+  std::atomic<std::uint64_t> hits;
+
+	/**
+   * Number of requested pages that had to be read from disk
+	 */
+  std::atomic<std::uint64_t> misses;
+
+	/**
+   * Number of pages read ahead by the prefetch thread
+	 */
+  std::atomic<std::uint64_t> prefetches;
+
+	/**
+   * Number of misses served from the compressed victim cache instead of the file
+	 */
+  std::atomic<std::uint64_t> victimCacheHits;
+
+	/**
+   * Number of pages evicted to make room for another page
+	 */
+  std::atomic<std::uint64_t> evictions;
+
+	/**
+   * Number of evicted pages which had to be written back by the evicting thread
+	 */
+  std::atomic<std::uint64_t> dirtyEvictions;
+
+	/**
+   * Number of pages written back by the background writer
+	 */
+  std::atomic<std::uint64_t> writerWrites;
+
+	/**
+   * Number of times a thread pinning a page had to wait for another thread's read of it
+	 */
+  std::atomic<std::uint64_t> pinWaits;
+
+	/**
+   * Number of times a thread found every frame pinned and waited for one to be unpinned
+	 */
+  std::atomic<std::uint64_t> allocWaits;
+
+	/**
+   * Number of those waits which timed out
+	 */
+  std::atomic<std::uint64_t> allocTimeouts;
+
+	/**
+   * Number of calls to BufMgr::commit() with a log attached
+	 */
+  std::atomic<std::uint64_t> commits;
+
+	/**
+   * Number of those commits which wrote and synced the log themselves; the others shared another commit's sync
+	 */
+  std::atomic<std::uint64_t> logFlushes;
+
+	/**
+   * Number of checkpoints taken, and of pages they wrote
+	 */
+  std::atomic<std::uint64_t> checkpoints;
+  std::atomic<std::uint64_t> checkpointWrites;
+
+	/**
+   * Time spent waiting for a frame to be unpinned
+	 */
+  LatencyHistogram allocWaitTime;
+
+	/**
+   * Latency of page reads from disk; the reads BufMgr::readPages() puts in flight together count once
+	 */
+  LatencyHistogram readLatency;
+
+	/**
+   * Latency of page writes to disk
+	 */
+  LatencyHistogram writeLatency;
+
+	/**
+   * Returns the fraction of requested pages found in the pool, 0 if none were requested
+	 */
+  double hitRatio() const
+  {
+		const std::uint64_t requests = hits + misses;
+		return requests == 0 ? 0.0 : (double) hits / requests;
+  }
+
+	/**
+   * Clear all values
+	 */
+  void clear();
+
+	/**
+   * Constructor of BufStats class
+	 */
+  BufStats()
+  {
+		clear();
+  }
+
+	/**
+   * Copies the current values of another BufStats
+	 */
+  BufStats(const BufStats& other)
+  {
+		*this = other;
+  }
+
+  BufStats& operator=(const BufStats& other);
+};
+
+
+/**
+* @brief Point in time copy of the statistics of a buffer pool, as returned by BufMgr::statsSnapshot()
+*/
+struct BufStatsSnapshot
+{
+	/**
+   * Name of the page replacement policy
+	 */
+  std::string policy;
+
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::uint32_t poolSize;
+
+	/**
+   * Bytes of compressed page images held by the victim cache
+	 */
+  std::size_t victimCacheBytes;
+
+	/**
+   * Pool wide counters and latency histograms
+	 */
+  BufStats totals;
+
+	/**
+   * Counters of each file used since the statistics were last cleared, by file name
+	 */
+  std::map<std::string, FileStats> files;
+
+	/**
+	 * Writes the snapshot as text, one "name value" line per counter, followed by the percentiles and the non-empty
+	 * buckets of each histogram and a line per file.
+	 *
+	 * @param out	Stream to write to
+	 */
+  void dump(std::ostream& out) const;
+};
+
+}
@@ -7,12 +7,22 @@
 
 #include <memory>
 #include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "exceptions/bad_pool_size_exception.h"
 
 namespace badgerdb { 
 
@@ -20,213 +30,1751 @@ namespace badgerdb {
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
-	bufDescTable = new BufDesc[bufs];
+BufMgr::BufMgr(std::uint32_t bufs, const ReplacementPolicyType policyType, std::uint32_t bufsMax)
+	: numBufs(bufs), maxBufs(bufsMax == 0 ? bufs * DEFAULT_GROWTH : std::max(bufs, bufsMax)),
+	  validBits(maxBufs), dirtyBits(maxBufs), log(NULL), pageWritesInFlight(0), checkpointFence(false),
+	  checkpointThread(NULL), checkpointRunning(false), checkpointInterval(0), writerThread(NULL), writerRunning(false),
+	  writerCleanTarget(0), writerInterval(0), readAheadDepth(DEFAULT_READ_AHEAD),
+	  prefetchThread(NULL),
+	  prefetchStopping(false), kernelRings(true) {
+  if (bufs == 0)
+    throw BadPoolSizeException(bufs, maxBufs);
 
-  for (FrameId i = 0; i < bufs; i++) 
+	bufDescTable = new BufDesc[maxBufs];
+
+  for (FrameId i = 0; i < maxBufs; i++) 
   {
   	bufDescTable[i].frameNo = i;
-  	bufDescTable[i].valid = false;
   }
 
-  bufPool = new Page[bufs];
+  // frames beyond the pool size stay pinned, so nobody takes them
+  pinCounts = allocAlignedArray<std::atomic<int> >(maxBufs);
+  for (FrameId i = 0; i < maxBufs; i++) 
+  	pinCounts[i] = i < bufs ? 0 : 1;
+  accessCounts = allocAlignedArray<std::atomic<std::uint32_t> >(maxBufs);
+  frameClasses = allocAlignedArray<std::atomic<std::uint8_t> >(maxBufs);
+  pageLsns = allocAlignedArray<std::atomic<Lsn> >(maxBufs);
+  for (FrameId i = 0; i < maxBufs; i++) 
+  {
+  	accessCounts[i] = 0;
+  	frameClasses[i] = HEAP_CLASS;
+  	pageLsns[i] = 0;
+  }
+  for (std::uint32_t i = 0; i < NUM_BUFFER_CLASSES; i++)
+  {
+    classFrames[i] = 0;
+    classMin[i] = 0;
+    classMax[i] = std::numeric_limits<std::uint32_t>::max();
+  }
+  quotasSet = false;
+  allocTimeout = 0;
+  allocWaiters = 0;
+  unpinGeneration = 0;
+
+  // reserve address space for the largest pool; memory is only committed once frames are used
+  void* memory = mmap(NULL, (std::size_t) maxBufs * sizeof(Page), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (memory == MAP_FAILED)
+    throw std::bad_alloc();
+  bufPool = static_cast<Page*>(memory);
+  for (FrameId i = 0; i < bufs; i++) 
+    new (&bufPool[i]) Page();
 
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+  hashTable = new BufHashTbl (bufs, NUM_PARTITIONS);  // allocate the buffer hash table
 
-  clockHand = bufs - 1;
+  policy = ReplacementPolicy::create(policyType, bufs, maxBufs);
+  evictable = [this](FrameId frameNo) { return pinCounts[frameNo] == 0; };
+  evictableClean = [this](FrameId frameNo) {
+    return pinCounts[frameNo] == 0 && !dirtyBits.test(frameNo);
+  };
 }
 
 
 BufMgr::~BufMgr() {
-  //Flush out all unwritten pages
-  for (std::uint32_t i = 0; i < numBufs; i++) 
+  if (prefetchThread != NULL)
   {
-  	BufDesc* tmpbuf = &bufDescTable[i];
-  	if (tmpbuf->valid == true && tmpbuf->dirty == true)
-		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-  	}
+    {
+      std::lock_guard<std::mutex> lock(prefetchLatch);
+      prefetchStopping = true;
+    }
+    prefetchWakeup.notify_one();
+    prefetchThread->join();
+    delete prefetchThread;
+  }
+  stopCheckpointer();
+  stopBackgroundWriter();
+
+  //Flush out all unwritten pages, file by file in page order
+  for (FilePageMap::const_iterator entry = filePages.begin(); entry != filePages.end(); ++entry)
+  {
+    File* file = NULL;
+    for (std::set<PageId>::const_iterator it = entry->second.begin(); it != entry->second.end(); ++it)
+    {
+      FrameId frameNo;
+      hashTable->lookup(entry->first, *it, frameNo);
+      BufDesc* tmpbuf = &bufDescTable[frameNo];
+      if (validBits.test(frameNo) && dirtyBits.test(frameNo))
+      {
+        file = tmpbuf->file;
+        forceLog(frameNo);
+        file->writePage(tmpbuf->pageNo, bufPool[frameNo]);
+      }
+    }
+    if (file != NULL)
+      file->sync();
   }
 
   delete [] bufDescTable;
-  delete [] bufPool;
+  freeAlignedArray(pinCounts, maxBufs);
+  freeAlignedArray(accessCounts, maxBufs);
+  freeAlignedArray(frameClasses, maxBufs);
+  freeAlignedArray(pageLsns, maxBufs);
+  munmap(bufPool, (std::size_t) maxBufs * sizeof(Page));
+  delete hashTable;
+  delete policy;
+  for (std::size_t i = 0; i < idleRings.size(); i++)
+    delete idleRings[i];
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+bool BufMgr::evictFrame(const FrameId frameNo, const File* onlyFile, const PageId onlyPage)
 {
-  // perform first part of clock algorithm to search for 
-  // open buffer frame
-  // Assumes non-concurrent access to buffer manager
-  std::uint32_t numScanned = 0;
-  bool found = 0;
+  BufDesc* tmpbuf = &bufDescTable[frameNo];
+
+  // claim the frame; this fails if anyone has it pinned
+  int unpinned = 0;
+  if (!pinCounts[frameNo].compare_exchange_strong(unpinned, 1))
+    return false;
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+  // a frame that holds no page is not in the hash table, so it is ours
+  if (!validBits.test(frameNo))
+    return true;
+
+  if (onlyFile != NULL && (tmpbuf->file != onlyFile || tmpbuf->pageNo != onlyPage))
   {
-    // advance the clock
-    advanceClock();
-    numScanned++;
+    unpinFrame(frameNo);
+    return false;
+  }
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
+  tmpbuf->evicting = true;
+  File* file = tmpbuf->file;
+  const PageId pageNo = tmpbuf->pageNo;
+  std::string image;
+
+  // flush any existing changes to disk if necessary.  This is done before the
+  // page leaves the hash table, so that a thread which misses on it afterwards
+  // reads the current version from disk.  A checkpoint must not find the page
+  // clean until the write is done; clean victims stay clear of its fence, as a
+  // page dirtied after it was found clean keeps the frame from being taken below.
+  bool dirty = dirtyBits.test(frameNo);
+  const bool logged = dirty && log != NULL;
+  if (logged)
+    beginPageWrite();
+  if (dirty)
+    dirty = dirtyBits.testAndReset(frameNo);
+
+  // the page is read below if it is written or compressed; threads pinning it
+  // from here on wait until we are done, and one that got in first keeps it
+  const bool readOut = dirty || victimCache.enabled();
+  if (readOut)
+  {
+    std::lock_guard<std::mutex> guard(latchFor(file, pageNo));
+    if (pinCounts[frameNo] != 1)
     {
-      break;
+      if (dirty)
+        dirtyBits.set(frameNo);
+      if (logged)
+        endPageWrite(NULL);
+      tmpbuf->evicting = false;
+      unpinFrame(frameNo);
+      return false;
+    }
+    tmpbuf->ioPending = true;
+  }
+
+  if (dirty)
+  {
+    try
+    {
+      bufStats.diskwrites++;
+      const LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
+      forceLog(frameNo);
+      file->writePage(pageNo, bufPool[frameNo]);
+      bufStats.writeLatency.record(start);
+    }
+    catch (...)
+    {
+      dirtyBits.set(frameNo);
+      if (logged)
+        endPageWrite(NULL);
+      tmpbuf->evicting = false;
+      completeIo(frameNo, true);
+      unpinFrame(frameNo);
+      throw;
+    }
+  }
+  if (logged)
+    endPageWrite(dirty ? file : NULL);
+
+  // compress the page for the victim cache before taking the latch; the image is
+  // only used if the page is still clean when it leaves the pool
+  const bool cached = victimCache.enabled() && CompressedPageCache::compress(bufPool[frameNo], image);
+
+  {
+    std::lock_guard<std::mutex> guard(latchFor(file, pageNo));
+    if (dirty)
+    {
+      bufStats.dirtyEvictions++;
+      fileStatsFor(file, pageNo).writes++;
+    }
+
+    // somebody may have pinned or dirtied the page while it was written out
+    if (pinCounts[frameNo] == 1 && !dirtyBits.test(frameNo))
+    {
+      bufStats.evictions++;
+      // a thread missing on the page once it is unmapped finds it in the victim cache
+      if (cached)
+        victimCache.insert(file, pageNo, image);
+      unmapPage(file, pageNo);
+      invalidateFrame(frameNo);
+      tmpbuf->file = NULL;
+      tmpbuf->pageNo = Page::INVALID_NUMBER;
+      tmpbuf->evicting = false;
+      // nobody else has a pin, so nobody waits on the write
+      tmpbuf->ioPending = false;
+      return true;
+    }
+  }
+
+  tmpbuf->evicting = false;
+  if (readOut)
+    completeIo(frameNo, true);
+  unpinFrame(frameNo);
+  return false;
+}
+
+void BufMgr::allocBuf(FrameId & frame, const File* file, BufferAccessStrategy* strategy) 
+{
+  // reuse the ring frame unless somebody else has taken it or is using it
+  if (strategy != NULL)
+  {
+    std::lock_guard<std::mutex> ringGuard(strategy->latch);
+    BufferAccessStrategy::Slot& slot = strategy->slots[strategy->current];
+    if (slot.file != NULL && evictFrame(slot.frameNo, slot.file, slot.pageNo))
+    {
+      frame = slot.frameNo;
+      return;
+    }
+  }
+
+  if (chooseVictim(frame, file))
+    return;
+
+  const std::uint32_t timeout = allocTimeout;
+  if (timeout == 0)
+  {
+    // full buffer pool
+    throw BufferExceededException();
+  }
+
+  // every frame is pinned; wait for one to be unpinned
+  bufStats.allocWaits++;
+  const LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
+  const LatencyHistogram::Clock::time_point deadline = start + std::chrono::milliseconds(timeout);
+  bool found;
+  allocWaiters++;
+  try
+  {
+    found = waitForVictim(frame, file, deadline);
+  }
+  catch (...)
+  {
+    allocWaiters--;
+    throw;
+  }
+  allocWaiters--;
+  bufStats.allocWaitTime.record(start);
+
+  if (!found)
+  {
+    bufStats.allocTimeouts++;
+    throw BufferExceededException();
+  }
+} // end allocBuf
+
+bool BufMgr::chooseVictim(FrameId& frame, const File* file)
+{
+  if (quotasSet)
+  {
+    const BufferClass requester = classOf(file);
+    const ReplacementPolicy::FrameFilter allowed = [this, requester](FrameId frameNo) {
+      return pinCounts[frameNo] == 0 && quotaAllows(requester, frameNo);
+    };
+    const ReplacementPolicy::FrameFilter allowedClean = [this, requester](FrameId frameNo) {
+      return pinCounts[frameNo] == 0 && !dirtyBits.test(frameNo) && quotaAllows(requester, frameNo);
+    };
+    if (takeVictim(frame, allowedClean, allowed))
+      return true;
+  }
+
+  // no victim within the quotas; any unpinned frame will do
+  return takeVictim(frame, evictableClean, evictable);
+}
+
+bool BufMgr::waitForVictim(FrameId& frame, const File* file,
+                           const LatencyHistogram::Clock::time_point deadline)
+{
+  while (true)
+  {
+    // a frame unpinned after this is seen either by chooseVictim() or by the wait
+    std::uint64_t generation;
+    {
+      std::lock_guard<std::mutex> lock(allocWaitLatch);
+      generation = unpinGeneration;
     }
+    if (chooseVictim(frame, file))
+      return true;
+
+    std::unique_lock<std::mutex> lock(allocWaitLatch);
+    if (!frameReleased.wait_until(lock, deadline, [this, generation] { return unpinGeneration != generation; }))
+      return false;
+  }
+}
+
+void BufMgr::notifyFrameReleased()
+{
+  {
+    std::lock_guard<std::mutex> lock(allocWaitLatch);
+    unpinGeneration++;
+  }
+  frameReleased.notify_all();
+}
+
+bool BufMgr::takeVictim(FrameId& frame, const ReplacementPolicy::FrameFilter& clean,
+                        const ReplacementPolicy::FrameFilter& any)
+{
+  // ask the policy for victims until one can be evicted; a victim may be
+  // pinned by another thread between being picked and being claimed
+  std::uint32_t numTried = 0;
+  FrameId candidate;
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+  // with a background writer, prefer victims that need no write
+  if (writerRunning)
+  {
+    while (numTried < numBufs && policy->pickVictim(candidate, clean))
     {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
+      numTried++;
+      if (evictFrame(candidate))
       {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
-        break;
+        frame = candidate;
+        return true;
       }
     }
-    else
+
+    // the writer is behind; get it going and write the victim ourselves
+    writerWakeup.notify_one();
+    numTried = 0;
+  }
+
+  while (numTried < numBufs && policy->pickVictim(candidate, any))
+  {
+    numTried++;
+    if (evictFrame(candidate))
     {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
+      // return new frame number
+      frame = candidate;
+      return true;
     }
   }
-  
-  // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+  return false;
+}
+
+bool BufMgr::quotaAllows(const BufferClass requester, const FrameId frameNo) const
+{
+  const bool valid = validBits.test(frameNo);
+  if (classFrames[requester] >= classMax[requester])
+    return valid && frameClasses[frameNo] == requester;
+
+  if (!valid)
+    return true;
+  const std::uint8_t victim = frameClasses[frameNo];
+  return victim == requester || classFrames[victim] > classMin[victim];
+}
+
+BufferClass BufMgr::classOf(const File* file)
+{
+  std::lock_guard<std::mutex> classGuard(fileClassesLatch);
+  std::map<const File*, BufferClass>::const_iterator entry = fileClasses.find(file);
+  return entry == fileClasses.end() ? HEAP_CLASS : entry->second;
+}
+
+void BufMgr::setFileClass(const File* file, const BufferClass bufferClass)
+{
+  std::lock_guard<std::mutex> classGuard(fileClassesLatch);
+  if (bufferClass == HEAP_CLASS)
+    fileClasses.erase(file);
+  else
+    fileClasses[file] = bufferClass;
+}
+
+void BufMgr::setClassQuota(const BufferClass bufferClass, const std::uint32_t minFrames,
+                           const std::uint32_t maxFrames)
+{
+  classMin[bufferClass] = minFrames;
+  classMax[bufferClass] = std::max(minFrames, maxFrames);
+  quotasSet = true;
+}
+
+bool BufMgr::pinResident(File* file, const PageId pageNo, FrameId& frameNo, const bool accessed)
+{
+  std::lock_guard<std::mutex> guard(latchFor(file, pageNo));
+  if (!hashTable->lookup(file, pageNo, frameNo))
+    return false;
+
+  pinCounts[frameNo]++;
+  if (accessed)
   {
-    throw BufferExceededException();
+    accessCounts[frameNo].fetch_add(1, std::memory_order_relaxed);
+    bufStats.hits++;
+    fileStatsFor(file, pageNo).hits++;
+    policy->pageAccessed(frameNo);
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+  return true;
+}
+
+bool BufMgr::waitForIo(const FrameId frameNo)
+{
+  BufDesc* tmpbuf = &bufDescTable[frameNo];
+  if (tmpbuf->ioPending)
   {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    bufStats.pinWaits++;
+    std::unique_lock<std::mutex> lock(ioWaitLatch);
+    while (tmpbuf->ioPending)
+      ioComplete.wait(lock);
   }
+  return validBits.test(frameNo);
+}
 
-	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+void BufMgr::completeIo(const FrameId frameNo, const bool success)
+{
+  BufDesc* tmpbuf = &bufDescTable[frameNo];
+  if (!success)
+  {
+    File* file = tmpbuf->file;
+    const PageId pageNo = tmpbuf->pageNo;
+    std::lock_guard<std::mutex> guard(latchFor(file, pageNo));
+    unmapPage(file, pageNo);
+    invalidateFrame(frameNo);
+    tmpbuf->file = NULL;
+    tmpbuf->pageNo = Page::INVALID_NUMBER;
+    policy->pageRemoved(frameNo);
+  }
 
-  // return new frame number
-  frame = clockHand;
-} // end allocBuf
+  {
+    std::lock_guard<std::mutex> lock(ioWaitLatch);
+    tmpbuf->ioPending = false;
+  }
+  ioComplete.notify_all();
+
+  // the reader's own pin goes away with a failed read
+  if (!success)
+    unpinFrame(frameNo);
+}
 
-	
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page,
+                      BufferAccessStrategy* strategy)
 {
-  // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
-  FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
+  bufStats.accesses++;
+  page = &bufPool[fetchPage(file, pageNo, strategy, true)];
+}
+
+bool BufMgr::installPage(File* file, const PageId pageNo, const FrameId newFrame, FrameId& frameNo,
+                         const bool accessed)
+{
+  std::lock_guard<std::mutex> guard(latchFor(file, pageNo));
+  if (hashTable->lookup(file, pageNo, frameNo))
+  {
+    // another thread read the page in the meantime
+    pinCounts[frameNo]++;
+    if (accessed)
+    {
+      accessCounts[frameNo].fetch_add(1, std::memory_order_relaxed);
+      bufStats.hits++;
+      fileStatsFor(file, pageNo).hits++;
+      policy->pageAccessed(frameNo);
+    }
+    policy->pageRemoved(newFrame);
+    unpinFrame(newFrame);
+    return false;
+  }
+
+  // set up the entry properly; readers which find it wait for the read
+  frameNo = newFrame;
+  setFrame(frameNo, file, pageNo);
+  bufDescTable[frameNo].ioPending = true;
+
+  // insert in the hash table
+  mapPage(file, pageNo, frameNo);
+  policy->pageLoaded(frameNo, file, pageNo);
 
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
+  if (accessed)
+  {
+    bufStats.misses++;
+    fileStatsFor(file, pageNo).misses++;
+  }
+  else
+  {
+    bufStats.prefetches++;
+    fileStatsFor(file, pageNo).prefetches++;
   }
-  catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
+  return true;
+}
+
+FrameId BufMgr::fetchPage(File* file, const PageId pageNo, BufferAccessStrategy* strategy,
+                          const bool accessed)
+{
+  // check to see if it is already in the buffer pool
+  FrameId frameNo = 0;
+  while (true)
   {
-    // alloc a new frame
-    allocBuf(frameNo);
+    if (!pinResident(file, pageNo, frameNo, accessed))
+    {
+      //not in the buffer pool, must allocate a new page
+      FrameId newFrame;
+      allocBuf(newFrame, file, strategy);
+      const bool loaded = installPage(file, pageNo, newFrame, frameNo, accessed);
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+      if (loaded)
+      {
+        takeRingSlot(strategy, frameNo, file, pageNo);
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+        // take the page from the victim cache, or read it into the new frame
+        if (victimCache.take(file, pageNo, bufPool[frameNo]))
+        {
+          bufStats.victimCacheHits++;
+          completeIo(frameNo, true);
+          return frameNo;
+        }
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+        try
+        {
+          bufStats.diskreads++;
+          const LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
+          file->readPage(pageNo, bufPool[frameNo]);
+          bufStats.readLatency.record(start);
+        }
+        catch (...)
+        {
+          completeIo(frameNo, false);
+          throw;
+        }
+        completeIo(frameNo, true);
+        return frameNo;
+      }
+    }
+
+    if (waitForIo(frameNo))
+      return frameNo;
+
+    // the read we waited on failed; drop our pin and try again ourselves
+    unpinFrame(frameNo);
   }
 }
 
+void BufMgr::takeRingSlot(BufferAccessStrategy* strategy, const FrameId frameNo, File* file, const PageId pageNo)
+{
+  if (strategy == NULL)
+    return;
 
-void BufMgr::unPinPage(File* file, const PageId pageNo, 
-			     const bool dirty) 
+  // the frame takes the current place in the ring
+  std::lock_guard<std::mutex> ringGuard(strategy->latch);
+  BufferAccessStrategy::Slot& slot = strategy->slots[strategy->current];
+  slot.frameNo = frameNo;
+  slot.file = file;
+  slot.pageNo = pageNo;
+  strategy->current = (strategy->current + 1) % strategy->slots.size();
+}
+
+void BufMgr::mapPage(File* file, const PageId pageNo, const FrameId frameNo)
 {
-  // lookup in hashtable
-  FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  hashTable->insert(file, pageNo, frameNo);
 
-  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+  std::lock_guard<std::mutex> dirGuard(filePagesLatch);
+  filePages[file].insert(pageNo);
+}
+
+void BufMgr::unmapPage(const File* file, const PageId pageNo)
+{
+  hashTable->remove(file, pageNo);
 
-  // make sure the page is actually pinned
-  if (bufDescTable[frameNo].pinCnt == 0)
+  std::lock_guard<std::mutex> dirGuard(filePagesLatch);
+  FilePageMap::iterator entry = filePages.find(file);
+  if (entry != filePages.end())
   {
-  	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+    entry->second.erase(pageNo);
+    if (entry->second.empty())
+      filePages.erase(entry);
   }
-  else bufDescTable[frameNo].pinCnt--;
 }
 
-void BufMgr::flushFile(const File* file) 
+void BufMgr::readPages(File* file, const std::vector<PageId>& pageNos, std::vector<Page*>& pages)
 {
-  for (std::uint32_t i = 0; i < numBufs; i++)
-	{
-  	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->valid == true && tmpbuf->file == file)
-		{
-	    if (tmpbuf->pinCnt > 0)
-  			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+  const std::size_t count = pageNos.size();
+  std::vector<FrameId> frames(count);
+  std::vector<bool> pinned(count, false);
+  // misses this call maps and reads itself, as (page number, index into pageNos)
+  std::vector<std::pair<PageId, std::size_t> > loads;
+  // loads whose read has completed, and the ring the reads are in flight on
+  std::vector<bool> loaded;
+  IoRing* ring = NULL;
+
+  bufStats.accesses += count;
+  try
+  {
+    for (std::size_t i = 0; i < count; i++)
+    {
+      if (!pinResident(file, pageNos[i], frames[i]))
+      {
+        FrameId newFrame;
+        allocBuf(newFrame, file);
+        if (installPage(file, pageNos[i], newFrame, frames[i], true))
+          loads.push_back(std::make_pair(pageNos[i], i));
+      }
+      pinned[i] = true;
+    }
+
+    // misses held by the victim cache need no read
+    std::size_t kept = 0;
+    for (std::size_t j = 0; j < loads.size(); j++)
+    {
+      const FrameId frameNo = frames[loads[j].second];
+      if (victimCache.take(file, loads[j].first, bufPool[frameNo]))
+      {
+        bufStats.victimCacheHits++;
+        completeIo(frameNo, true);
+      }
+      else
+        loads[kept++] = loads[j];
+    }
+    loads.resize(kept);
+
+    // put the reads of the misses in flight in page order, one per run of consecutive pages, and finish each as it
+    // completes
+    std::sort(loads.begin(), loads.end());
+    loaded.assign(loads.size(), false);
+    if (!loads.empty())
+    {
+      // runs of loads, as (index of the first load, number of loads)
+      std::vector<std::pair<std::size_t, std::size_t> > runs;
+      std::vector<struct iovec> buffers(loads.size());
+      for (std::size_t j = 0; j < loads.size(); j++)
+      {
+        buffers[j].iov_base = &bufPool[frames[loads[j].second]];
+        buffers[j].iov_len = Page::SIZE;
+        if (!runs.empty() && runs.back().second < IO_RUN_PAGES && loads[j].first == loads[j - 1].first + 1)
+          runs.back().second++;
+        else
+          runs.push_back(std::make_pair(j, (std::size_t) 1));
+      }
+
+      ring = acquireRing();
+      bufStats.diskreads += loads.size();
+      const LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
+      std::size_t submitted = 0;
+      IoRing::Completion completion;
+      while (submitted < runs.size() || ring->outstanding() > 0)
+      {
+        while (submitted < runs.size() && !ring->full())
+        {
+          const std::pair<std::size_t, std::size_t>& run = runs[submitted];
+          file->prepareReadRun(*ring, loads[run.first].first, &buffers[run.first], (int) run.second, submitted);
+          submitted++;
+        }
+        // a read is outstanding, so this returns its completion
+        ring->wait(completion);
+
+        const std::pair<std::size_t, std::size_t>& run = runs[(std::size_t) completion.tag];
+        for (std::size_t k = 0; k < run.second; k++)
+        {
+          const std::size_t j = run.first + k;
+          const FrameId frameNo = frames[loads[j].second];
+          file->completeReadPage(loads[j].first, bufPool[frameNo], File::runPageResult(completion.result, k));
+          loaded[j] = true;
+          completeIo(frameNo, true);
+        }
+      }
+      bufStats.readLatency.record(start);
+      releaseRing(ring);
+      ring = NULL;
+    }
+  }
+  catch (...)
+  {
+    // no read may still land in a frame given back; wait() only gives up once none is in flight
+    if (ring != NULL)
+    {
+      IoRing::Completion completion;
+      while (ring->wait(completion))
+      {
+      }
+      releaseRing(ring);
+    }
+    // give everything back; failed reads drop their own pins
+    for (std::size_t j = 0; j < loads.size(); j++)
+    {
+      if (j < loaded.size() && loaded[j])
+        continue;
+      pinned[loads[j].second] = false;
+      completeIo(frames[loads[j].second], false);
+    }
+    for (std::size_t i = 0; i < count; i++)
+    {
+      if (pinned[i])
+      {
+        waitForIo(frames[i]);
+        unpinFrame(frames[i]);
+      }
+    }
+    throw;
+  }
+
+  // pages other threads were reading in the meantime
+  pages.resize(count);
+  for (std::size_t i = 0; i < count; i++)
+  {
+    if (!waitForIo(frames[i]))
+    {
+      // their read failed; read the page ourselves
+      unpinFrame(frames[i]);
+      pinned[i] = false;
+      try
+      {
+        frames[i] = fetchPage(file, pageNos[i], NULL, true);
+      }
+      catch (...)
+      {
+        for (std::size_t j = 0; j < count; j++)
+        {
+          if (pinned[j] && j != i)
+            unpinFrame(frames[j]);
+        }
+        throw;
+      }
+      pinned[i] = true;
+    }
+    pages[i] = &bufPool[frames[i]];
+  }
+}
+
+void BufMgr::setAsyncIo(const bool enabled)
+{
+  std::lock_guard<std::mutex> guard(ringLatch);
+  kernelRings = enabled;
+  for (std::size_t i = 0; i < idleRings.size(); i++)
+    delete idleRings[i];
+  idleRings.clear();
+}
 
-	    if (tmpbuf->dirty == true)
-			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
-    	}
+bool BufMgr::asyncIo()
+{
+  std::lock_guard<std::mutex> guard(ringLatch);
+  return kernelRings;
+}
 
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
-  	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+IoRing* BufMgr::acquireRing()
+{
+  bool useKernel;
+  {
+    std::lock_guard<std::mutex> guard(ringLatch);
+    if (!idleRings.empty())
+    {
+      IoRing* ring = idleRings.back();
+      idleRings.pop_back();
+      return ring;
+    }
+    useKernel = kernelRings;
   }
+  return new IoRing(IO_RING_DEPTH, useKernel);
 }
 
-void BufMgr::disposePage(File* file, const PageId pageNo) 
+void BufMgr::releaseRing(IoRing* ring)
 {
-	//Deallocate from file altogether
-  //See if it is in the buffer pool
+  std::lock_guard<std::mutex> guard(ringLatch);
+  if (ring->async() == kernelRings)
+    idleRings.push_back(ring);
+  else
+    delete ring;
+}
+
+void BufMgr::unPinPage(File* file, const PageId pageNo, 
+			     const bool dirty) 
+{
+  // lookup in hashtable
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  {
+    std::lock_guard<std::mutex> guard(latchFor(file, pageNo));
+    if (!hashTable->lookup(file, pageNo, frameNo))
+      throw HashNotFoundException(file->filename(), pageNo);
+  }
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+  // an unpin of an unpinned page must neither dirty nor log it
+  if (pinCounts[frameNo] == 0)
+    throw PageNotPinnedException(file->filename(), pageNo, frameNo);
 
-	hashTable->remove(file, pageNo);
+  if (dirty == true)
+  {
+    dirtyBits.set(frameNo);
+    if (log != NULL)
+    {
+      // the image is taken while our pin keeps the page in the frame
+      const Lsn lsn = log->logPage(file, pageNo, bufPool[frameNo]);
+      Lsn last = pageLsns[frameNo];
+      while (last < lsn && !pageLsns[frameNo].compare_exchange_weak(last, lsn))
+      {
+      }
+    }
+  }
 
-  // deallocate it in the file	
-  file->deletePage(pageNo);
-}
+  // make sure the page is still pinned
+  int pins = pinCounts[frameNo];
+  do
+  {
+    if (pins == 0)
+    {
+      throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+    }
+  } while (!pinCounts[frameNo].compare_exchange_weak(pins, pins - 1));
 
+  if (pins == 1 && allocWaiters > 0)
+    notifyFrameReleased();
+}
 
-void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+void BufMgr::flushFile(const File* file) 
 {
-  FrameId frameNo;
+  cancelPrefetches(file);
+  std::lock_guard<std::mutex> writerGuard(writerBatchLatch);
 
-  // alloc a new frame
-  allocBuf(frameNo);
+  // the file's resident pages, in page order
+  std::vector<PageId> pageNos;
+  {
+    std::lock_guard<std::mutex> dirGuard(filePagesLatch);
+    FilePageMap::const_iterator entry = filePages.find(file);
+    if (entry != filePages.end())
+      pageNos.assign(entry->second.begin(), entry->second.end());
+  }
 
-  // allocate a new page in the file
-	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
-  page = &bufPool[frameNo];
+  bool written = false;
+  std::size_t i = 0;
+  while (i < pageNos.size())
+  {
+    const PageId pageNo = pageNos[i];
+    FrameId frameNo;
+    std::unique_lock<std::mutex> guard(latchFor(file, pageNo));
+    // the page may have been evicted before we got the latch
+    if (!hashTable->lookup(file, pageNo, frameNo))
+    {
+      i++;
+      continue;
+    }
 
-  // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
+    BufDesc* tmpbuf = &(bufDescTable[frameNo]);
+    if (!validBits.test(frameNo))
+      throw BadBufferException(frameNo, dirtyBits.test(frameNo), validBits.test(frameNo), false);
 
-  // insert in the hash table
-  hashTable->insert(file, pageNo, frameNo);
+    int unpinned = 0;
+    if (!pinCounts[frameNo].compare_exchange_strong(unpinned, 1))
+    {
+      if (!tmpbuf->evicting)
+        throw PagePinnedException(file->filename(), pageNo, frameNo);
+
+      // the clock is taking the frame; let it finish and look again
+      guard.unlock();
+      std::this_thread::yield();
+      continue;
+    }
+
+    if (dirtyBits.test(frameNo))
+    {
+      bufStats.diskwrites++;
+      const LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
+      forceLog(frameNo);
+      tmpbuf->file.load()->writePage(pageNo, bufPool[frameNo]);
+      bufStats.writeLatency.record(start);
+      fileStatsFor(file, pageNo).writes++;
+      fileWritten(file);
+      dirtyBits.reset(frameNo);
+      written = true;
+    }
+
+    unmapPage(file, pageNo);
+    policy->pageRemoved(frameNo);
+    clearFrame(frameNo);
+    i++;
+  }
+
+  // the file may be closed once flushed, and another one opened at its address
+  victimCache.removeFile(file);
+  policy->fileFlushed(file);
+  retireFileStats(file);
+  {
+    std::lock_guard<std::mutex> restructuredGuard(restructuredLatch);
+    if (restructuredFiles.erase(file) > 0)
+      written = true;
+  }
+  {
+    std::lock_guard<std::mutex> lock(pageWriteLatch);
+    if (unsyncedFiles.erase(file) > 0)
+      written = true;
+  }
+
+  if (written)
+  {
+    file->sync();
+  }
+}
+
+void BufMgr::disposePage(File* file, const PageId pageNo) 
+{
+	//Deallocate from file altogether
+  //See if it is in the buffer pool
+  FrameId frameNo = 0;
+  cancelPrefetches(file);
+  std::lock_guard<std::mutex> writerGuard(writerBatchLatch);
+  std::lock_guard<std::mutex> listGuard(pageListLatch);
+  while (true)
+  {
+    std::unique_lock<std::mutex> guard(latchFor(file, pageNo));
+    if (!hashTable->lookup(file, pageNo, frameNo))
+      break;
+
+    BufDesc* tmpbuf = &bufDescTable[frameNo];
+    int unpinned = 0;
+    if (pinCounts[frameNo].compare_exchange_strong(unpinned, 1))
+    {
+      unmapPage(file, pageNo);
+      policy->pageRemoved(frameNo);
+      // clear the page
+      clearFrame(frameNo);
+      break;
+    }
+    if (!tmpbuf->evicting)
+      throw PagePinnedException(file->filename(), pageNo, frameNo);
+
+    // the clock is taking the frame; let it finish
+    guard.unlock();
+    std::this_thread::yield();
+  }
+
+  // deallocate it in the file, and relink its neighbours in the pool as on disk
+  PageId prevPageNo;
+  PageId nextPageNo;
+  file->pageLinks(pageNo, prevPageNo, nextPageNo);
+  file->deletePage(pageNo);
+  victimCache.remove(file, pageNo);
+  refreshLink(file, prevPageNo, true, nextPageNo);
+  refreshLink(file, nextPageNo, false, prevPageNo);
+  if (log != NULL)
+  {
+    std::lock_guard<std::mutex> restructuredGuard(restructuredLatch);
+    restructuredFiles.insert(file);
+  }
+}
+
+
+void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+{
+  FrameId frameNo;
+
+  // alloc a new frame
+  allocBuf(frameNo, file);
+
+  // allocate a new page in the file
+	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
+  std::lock_guard<std::mutex> listGuard(pageListLatch);
+  try
+  {
+    file->allocatePage(pageNo, bufPool[frameNo]);
+    victimCache.remove(file, pageNo);
+  }
+  catch (...)
+  {
+    policy->pageRemoved(frameNo);
+    unpinFrame(frameNo);
+    throw;
+  }
+  page = &bufPool[frameNo];
+  if (log != NULL)
+  {
+    std::lock_guard<std::mutex> restructuredGuard(restructuredLatch);
+    restructuredFiles.insert(file);
+  }
+
+  {
+    // set up the entry properly
+    std::lock_guard<std::mutex> guard(latchFor(file, pageNo));
+    setFrame(frameNo, file, pageNo);
+
+    // insert in the hash table
+    mapPage(file, pageNo, frameNo);
+    policy->pageLoaded(frameNo, file, pageNo);
+  }
+
+  // the new page was appended after the old last page
+  refreshLink(file, page->prev_page_number(), true, pageNo);
+}
+
+void BufMgr::refreshLink(File* file, const PageId pageNo, const bool next, const PageId linked)
+{
+  if (pageNo == Page::INVALID_NUMBER)
+    return;
+
+  FrameId frameNo;
+  {
+    std::lock_guard<std::mutex> guard(latchFor(file, pageNo));
+    // an eviction of the page either cached the image already or sees our pin
+    victimCache.remove(file, pageNo);
+    if (!hashTable->lookup(file, pageNo, frameNo))
+      return;
+    pinCounts[frameNo]++;
+  }
+
+  // a read in flight may still bring in the old link
+  if (waitForIo(frameNo))
+  {
+    std::lock_guard<std::mutex> guard(latchFor(file, pageNo));
+    if (next)
+      bufPool[frameNo].set_next_page_number(linked);
+    else
+      bufPool[frameNo].set_prev_page_number(linked);
+  }
+  unpinFrame(frameNo);
+}
+
+void BufMgr::commit()
+{
+  if (log == NULL)
+    return;
+
+  // allocations and deletions change the file header and page list in place
+  std::set<const File*> files;
+  {
+    std::lock_guard<std::mutex> restructuredGuard(restructuredLatch);
+    files.swap(restructuredFiles);
+  }
+  try
+  {
+    for (std::set<const File*>::const_iterator it = files.begin(); it != files.end(); ++it)
+      (*it)->sync();
+  }
+  catch (...)
+  {
+    std::lock_guard<std::mutex> restructuredGuard(restructuredLatch);
+    restructuredFiles.insert(files.begin(), files.end());
+    throw;
+  }
+
+  bufStats.commits++;
+  if (log->flush(log->endLsn()))
+    bufStats.logFlushes++;
+}
+
+void BufMgr::startBackgroundWriter(const std::uint32_t cleanTarget, const std::uint32_t intervalMs)
+{
+  if (writerThread != NULL)
+    return;
+
+  writerCleanTarget = cleanTarget;
+  writerInterval = intervalMs;
+  writerRunning = true;
+  writerThread = new std::thread(&BufMgr::backgroundWriterLoop, this);
+}
+
+void BufMgr::stopBackgroundWriter()
+{
+  if (writerThread == NULL)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(writerSleepLatch);
+    writerRunning = false;
+  }
+  writerWakeup.notify_one();
+  writerThread->join();
+  delete writerThread;
+  writerThread = NULL;
+}
+
+void BufMgr::backgroundWriterLoop()
+{
+  while (writerRunning)
+  {
+    try
+    {
+      writeUpcomingVictims();
+    }
+    catch (...)
+    {
+      // the page stays dirty and is written when it is evicted
+    }
+
+    std::unique_lock<std::mutex> lock(writerSleepLatch);
+    if (writerRunning)
+      writerWakeup.wait_for(lock, std::chrono::milliseconds(writerInterval));
+  }
+}
+
+std::uint32_t BufMgr::writeUpcomingVictims()
+{
+  std::lock_guard<std::mutex> writerGuard(writerBatchLatch);
+
+  std::vector<FrameId> victims;
+  policy->upcomingVictims(writerCleanTarget, evictable, victims);
+  const std::uint32_t written = writeFrames(victims);
+  bufStats.writerWrites += written;
+  return written;
+}
+
+std::uint32_t BufMgr::writeFrames(const std::vector<FrameId>& frames)
+{
+  // claim the dirty unpinned ones; threads pinning them while they are written wait for the write
+  std::vector<std::pair<std::pair<File*, PageId>, FrameId> > batch;
+  for (std::uint32_t i = 0; i < frames.size(); i++)
+  {
+    BufDesc* tmpbuf = &bufDescTable[frames[i]];
+    if (!dirtyBits.test(frames[i]) || !validBits.test(frames[i]))
+      continue;
+
+    File* file = tmpbuf->file;
+    const PageId pageNo = tmpbuf->pageNo;
+    FrameId frameNo;
+    std::lock_guard<std::mutex> guard(latchFor(file, pageNo));
+    int unpinned = 0;
+    if (hashTable->lookup(file, pageNo, frameNo) && frameNo == frames[i] &&
+        pinCounts[frameNo].compare_exchange_strong(unpinned, 1))
+    {
+      tmpbuf->ioPending = true;
+      batch.push_back(std::make_pair(std::make_pair(file, pageNo), frameNo));
+    }
+  }
+
+  // write in file and page order
+  std::sort(batch.begin(), batch.end());
+  std::uint32_t written = 0;
+  for (std::uint32_t i = 0; i < batch.size(); i++)
+  {
+    const FrameId frameNo = batch[i].second;
+    if (dirtyBits.testAndReset(frameNo))
+    {
+      try
+      {
+        bufStats.diskwrites++;
+        const LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
+        forceLog(frameNo);
+        batch[i].first.first->writePage(batch[i].first.second, bufPool[frameNo]);
+        bufStats.writeLatency.record(start);
+        fileWritten(batch[i].first.first);
+        written++;
+      }
+      catch (...)
+      {
+        dirtyBits.set(frameNo);
+        completeIo(frameNo, true);
+        unpinFrame(frameNo);
+        continue;
+      }
+
+      std::lock_guard<std::mutex> guard(latchFor(batch[i].first.first, batch[i].first.second));
+      fileStatsFor(batch[i].first.first, batch[i].first.second).writes++;
+    }
+    completeIo(frameNo, true);
+    unpinFrame(frameNo);
+  }
+  return written;
+}
+
+void BufMgr::beginPageWrite()
+{
+  std::unique_lock<std::mutex> lock(pageWriteLatch);
+  while (checkpointFence)
+    pageWritesDone.wait(lock);
+  pageWritesInFlight++;
+}
+
+void BufMgr::endPageWrite(const File* written)
+{
+  {
+    std::lock_guard<std::mutex> lock(pageWriteLatch);
+    if (written != NULL)
+      unsyncedFiles.insert(written);
+    pageWritesInFlight--;
+    if (pageWritesInFlight > 0 || !checkpointFence)
+      return;
+  }
+  pageWritesDone.notify_all();
+}
+
+Lsn BufMgr::checkpoint()
+{
+  if (log == NULL)
+    return 0;
+
+  std::lock_guard<std::mutex> checkpointGuard(checkpointLatch);
+  // every record logged from here on is kept
+  const Lsn start = log->endLsn();
+
+  // write the dirty pages a batch at a time, so flushFile() and the background writer get their turn
+  std::uint32_t written = 0;
+  std::vector<FrameId> frames;
+  for (FrameId first = 0; first < numBufs; first += CHECKPOINT_BATCH)
+  {
+    frames.clear();
+    const FrameId last = std::min<FrameId>(first + CHECKPOINT_BATCH, numBufs);
+    for (FrameId i = first; i < last; i++)
+    {
+      if (pinCounts[i] == 0 && dirtyBits.test(i))
+        frames.push_back(i);
+    }
+    if (frames.empty())
+      continue;
+
+    std::lock_guard<std::mutex> writerGuard(writerBatchLatch);
+    written += writeFrames(frames);
+  }
+  bufStats.checkpointWrites += written;
+
+  // flushFile() must not sync and forget a file while we are about to sync it
+  std::lock_guard<std::mutex> writerGuard(writerBatchLatch);
+  Lsn redoStart = start;
+  std::set<const File*> files;
+  {
+    // with no eviction between taking a dirty bit and noting its write, a page is either dirty, and its last
+    // record is kept, or written with its file among those synced below
+    std::unique_lock<std::mutex> lock(pageWriteLatch);
+    checkpointFence = true;
+    while (pageWritesInFlight > 0)
+      pageWritesDone.wait(lock);
+
+    const std::uint32_t poolSize = numBufs;
+    for (FrameId i = 0; i < poolSize; i++)
+    {
+      if (!validBits.test(i) || !dirtyBits.test(i))
+        continue;
+      const Lsn lsn = pageLsns[i];
+      if (lsn <= redoStart)
+        redoStart = lsn == 0 ? 0 : lsn - 1;
+    }
+    files.swap(unsyncedFiles);
+    checkpointFence = false;
+  }
+  pageWritesDone.notify_all();
+
+  {
+    std::lock_guard<std::mutex> restructuredGuard(restructuredLatch);
+    files.insert(restructuredFiles.begin(), restructuredFiles.end());
+  }
+  try
+  {
+    for (std::set<const File*>::const_iterator it = files.begin(); it != files.end(); ++it)
+      (*it)->sync();
+  }
+  catch (...)
+  {
+    std::lock_guard<std::mutex> lock(pageWriteLatch);
+    unsyncedFiles.insert(files.begin(), files.end());
+    throw;
+  }
+
+  bufStats.checkpoints++;
+  return log->discardBefore(redoStart);
+}
+
+void BufMgr::startCheckpointer(const std::uint32_t intervalMs)
+{
+  if (checkpointThread != NULL)
+    return;
+
+  checkpointInterval = intervalMs;
+  checkpointRunning = true;
+  checkpointThread = new std::thread(&BufMgr::checkpointLoop, this);
+}
+
+void BufMgr::stopCheckpointer()
+{
+  if (checkpointThread == NULL)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(checkpointSleepLatch);
+    checkpointRunning = false;
+  }
+  checkpointWakeup.notify_one();
+  checkpointThread->join();
+  delete checkpointThread;
+  checkpointThread = NULL;
+}
+
+void BufMgr::checkpointLoop()
+{
+  while (checkpointRunning)
+  {
+    {
+      std::unique_lock<std::mutex> lock(checkpointSleepLatch);
+      if (checkpointRunning)
+        checkpointWakeup.wait_for(lock, std::chrono::milliseconds(checkpointInterval));
+    }
+    if (!checkpointRunning)
+      return;
+
+    try
+    {
+      checkpoint();
+    }
+    catch (...)
+    {
+      // the log keeps its records; the next checkpoint tries again
+    }
+  }
+}
+
+void BufMgr::prefetchChain(File* file, const PageId pageNo, const std::uint32_t depth,
+                           const NextPageFn& next, BufferAccessStrategy* strategy)
+{
+  if (depth == 0 || pageNo == Page::INVALID_NUMBER)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(prefetchLatch);
+    if (prefetchStopping)
+      return;
+
+    // read-ahead is only a hint; don't queue more than the pool could hold
+    if (prefetchQueue.size() >= numBufs)
+      return;
+    for (std::deque<PrefetchRequest>::const_iterator it = prefetchQueue.begin(); it != prefetchQueue.end(); ++it)
+    {
+      if (it->file == file && it->pageNo == pageNo)
+        return;
+    }
+
+    PrefetchRequest request = { file, pageNo, depth, next, strategy };
+    prefetchQueue.push_back(request);
+
+    if (prefetchThread == NULL)
+      prefetchThread = new std::thread(&BufMgr::prefetchLoop, this);
+  }
+  prefetchWakeup.notify_one();
+}
+
+void BufMgr::readAheadFrom(File* file, const PageId pageNo, const PageId nextPageNo, std::atomic<PageId>& cursor,
+                           const NextPageFn& next, BufferAccessStrategy* strategy)
+{
+  const std::uint32_t depth = readAheadDepth;
+  if (depth == 0)
+    return;
+
+  std::atomic<PageId>* last = &cursor;
+  const NextPageFn follow = [last, next](const Page& page) {
+    const PageId nextNo = next(page);
+    if (nextNo != Page::INVALID_NUMBER)
+      *last = nextNo;
+    return nextNo;
+  };
+
+  const PageId end = cursor;
+  if (end == Page::INVALID_NUMBER || end == pageNo)
+  {
+    // the scan has caught up with its window (or just started); read a new one
+    cursor = nextPageNo;
+    prefetchChain(file, nextPageNo, depth, follow, strategy);
+  }
+  else
+  {
+    // the pages up to the cursor have been asked for already; the end of the window is a hit
+    prefetchChain(file, end, 2, follow, strategy);
+  }
+}
+
+void BufMgr::prefetchLoop()
+{
+  std::unique_lock<std::mutex> lock(prefetchLatch);
+  while (true)
+  {
+    while (!prefetchStopping && prefetchQueue.empty())
+      prefetchWakeup.wait(lock);
+    if (prefetchStopping)
+      return;
+
+    std::vector<PrefetchRequest> batch;
+    while (!prefetchQueue.empty() && batch.size() < PREFETCH_BATCH)
+    {
+      batch.push_back(prefetchQueue.front());
+      prefetchQueue.pop_front();
+      prefetchInFlight.insert(batch.back().file);
+    }
+    lock.unlock();
+
+    prefetchBatch(batch);
+
+    lock.lock();
+    // follow the chains first, in their order, unless their file has been flushed meanwhile
+    for (std::size_t i = batch.size(); i-- > 0; )
+    {
+      if (batch[i].depth > 0 && prefetchCancelled.count(batch[i].file) == 0)
+        prefetchQueue.push_front(batch[i]);
+    }
+    prefetchInFlight.clear();
+    prefetchCancelled.clear();
+    prefetchDone.notify_all();
+  }
+}
+
+void BufMgr::prefetchBatch(std::vector<PrefetchRequest>& batch)
+{
+  const std::size_t count = batch.size();
+  std::vector<FrameId> frames(count);
+  std::vector<bool> pinned(count, false);
+  // requests whose page this call reads itself
+  std::vector<std::size_t> loads;
+
+  for (std::size_t i = 0; i < count; i++)
+  {
+    PrefetchRequest& request = batch[i];
+    try
+    {
+      if (!pinResident(request.file, request.pageNo, frames[i], false))
+      {
+        FrameId newFrame;
+        allocBuf(newFrame, request.file, request.strategy);
+        if (installPage(request.file, request.pageNo, newFrame, frames[i], false))
+        {
+          takeRingSlot(request.strategy, frames[i], request.file, request.pageNo);
+          if (victimCache.take(request.file, request.pageNo, bufPool[frames[i]]))
+          {
+            bufStats.victimCacheHits++;
+            completeIo(frames[i], true);
+          }
+          else
+            loads.push_back(i);
+        }
+      }
+      pinned[i] = true;
+    }
+    catch (...)
+    {
+      // no free frame; the reader will find out itself
+      request.depth = 0;
+    }
+  }
+
+  if (!loads.empty())
+  {
+    IoRing* ring = acquireRing();
+    bufStats.diskreads += loads.size();
+    const LatencyHistogram::Clock::time_point start = LatencyHistogram::Clock::now();
+    std::size_t submitted = 0;
+    IoRing::Completion completion;
+    while (submitted < loads.size() || ring->outstanding() > 0)
+    {
+      while (submitted < loads.size() && !ring->full())
+      {
+        const std::size_t i = loads[submitted];
+        batch[i].file->prepareReadPage(*ring, batch[i].pageNo, bufPool[frames[i]], submitted);
+        submitted++;
+      }
+      // a read is outstanding, so this returns its completion
+      ring->wait(completion);
+
+      const std::size_t i = loads[(std::size_t) completion.tag];
+      try
+      {
+        batch[i].file->completeReadPage(batch[i].pageNo, bufPool[frames[i]], completion.result);
+      }
+      catch (...)
+      {
+        // the page can't be read; the reader will find out itself
+        pinned[i] = false;
+        batch[i].depth = 0;
+        completeIo(frames[i], false);
+        continue;
+      }
+      completeIo(frames[i], true);
+    }
+    bufStats.readLatency.record(start);
+    releaseRing(ring);
+  }
+
+  // pages other threads were reading in the meantime are waited for; then follow each chain
+  for (std::size_t i = 0; i < count; i++)
+  {
+    if (!pinned[i])
+      continue;
+    PrefetchRequest& request = batch[i];
+    if (!waitForIo(frames[i]))
+      request.depth = 0;
+    else if (--request.depth > 0)
+    {
+      request.pageNo = request.next(bufPool[frames[i]]);
+      if (request.pageNo == Page::INVALID_NUMBER)
+        request.depth = 0;
+    }
+    unpinFrame(frames[i]);
+  }
+}
+
+void BufMgr::cancelPrefetches(const File* file)
+{
+  std::unique_lock<std::mutex> lock(prefetchLatch);
+  while (true)
+  {
+    for (std::deque<PrefetchRequest>::iterator it = prefetchQueue.begin(); it != prefetchQueue.end(); )
+    {
+      if (it->file == file)
+        it = prefetchQueue.erase(it);
+      else
+        ++it;
+    }
+    if (prefetchInFlight.count(file) == 0)
+      return;
+
+    // the rest of its chains must not be queued again
+    prefetchCancelled.insert(file);
+    prefetchDone.wait(lock);
+  }
+}
+
+void BufMgr::resize(const std::uint32_t newBufs)
+{
+  if (newBufs == 0 || newBufs > maxBufs)
+    throw BadPoolSizeException(newBufs, maxBufs);
+
+  std::lock_guard<std::mutex> resizeGuard(resizeLatch);
+  const std::uint32_t oldBufs = numBufs;
+
+  if (newBufs > oldBufs)
+  {
+    // new frames start out empty and unpinned
+    for (FrameId i = oldBufs; i < newBufs; i++)
+      new (&bufPool[i]) Page();
+    policy->resize(newBufs);
+    numBufs = newBufs;
+    for (FrameId i = oldBufs; i < newBufs; i++)
+      clearFrame(i);
+  }
+  else if (newBufs < oldBufs)
+  {
+    // take every frame beyond the new size away from its page; they stay pinned by us
+    FrameId i = newBufs;
+    try
+    {
+      for (; i < oldBufs; i++)
+      {
+        while (!evictFrame(i))
+        {
+          if (bufDescTable[i].evicting)
+          {
+            // the clock is taking the frame; let it finish and look again
+            std::this_thread::yield();
+            continue;
+          }
+
+          // a pinned page
+          File* file = bufDescTable[i].file;
+          const PageId pageNo = bufDescTable[i].pageNo;
+          throw PagePinnedException(file != NULL ? file->filename() : std::string(), pageNo, i);
+        }
+      }
+    }
+    catch (...)
+    {
+      // give back the frames taken so far, whether a page was pinned or could not be written
+      for (FrameId j = newBufs; j < i; j++)
+      {
+        policy->pageRemoved(j);
+        clearFrame(j);
+      }
+      throw;
+    }
+
+    for (FrameId i = newBufs; i < oldBufs; i++)
+      policy->pageRemoved(i);
+    policy->resize(newBufs);
+    numBufs = newBufs;
+
+    // hand the memory of the released frames back to the system
+    madvise(&bufPool[newBufs], (std::size_t) (oldBufs - newBufs) * sizeof(Page), MADV_DONTNEED);
+  }
+
+  for (std::uint32_t i = 0; i < NUM_PARTITIONS; i++)
+  {
+    std::lock_guard<std::mutex> guard(partitionLatch[i]);
+    hashTable->resize(i, newBufs);
+  }
+}
+
+void BufMgr::dumpResidentPages(const std::string& filename)
+{
+  // a frame may change hands while we look at it; the list is only a hint.  A file
+  // listed in filePages has resident pages, so it has not been flushed and closed.
+  std::vector<std::pair<std::string, std::pair<PageId, std::uint32_t> > > resident;
+  {
+    std::lock_guard<std::mutex> dirGuard(filePagesLatch);
+    const std::uint32_t frames = numBufs;
+    for (FrameId i = 0; i < frames; i++)
+    {
+      File* file = bufDescTable[i].file;
+      if (!validBits.test(i) || file == NULL || filePages.find(file) == filePages.end())
+        continue;
+      resident.push_back(std::make_pair(file->filename(), std::make_pair(bufDescTable[i].pageNo.load(),
+                                                                         accessCounts[i].load())));
+    }
+  }
+
+  const std::string tempname = filename + ".tmp";
+  {
+    std::ofstream out;
+    out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    out.open(tempname.c_str(), std::ofstream::out | std::ofstream::trunc);
+    for (std::size_t i = 0; i < resident.size(); i++)
+      out << resident[i].second.first << " " << resident[i].second.second << " " << resident[i].first << "\n";
+  }
+  if (std::rename(tempname.c_str(), filename.c_str()) != 0)
+    throw std::ios_base::failure("cannot rename " + tempname + " to " + filename);
+}
+
+std::uint32_t BufMgr::warmUp(const std::string& filename, const std::vector<File*>& files,
+                             const std::uint32_t maxPages)
+{
+  std::ifstream in(filename.c_str());
+  if (!in)
+    return 0;
+
+  std::map<std::string, File*> byName;
+  for (std::size_t i = 0; i < files.size(); i++)
+    byName[files[i]->filename()] = files[i];
+
+  // (temperature, (file, page)) of the listed pages of the given files
+  std::vector<std::pair<std::uint32_t, std::pair<File*, PageId> > > listed;
+  PageId pageNo;
+  std::uint32_t temperature;
+  std::string name;
+  while (in >> pageNo >> temperature && std::getline(in >> std::ws, name))
+  {
+    std::map<std::string, File*>::const_iterator file = byName.find(name);
+    if (file != byName.end())
+      listed.push_back(std::make_pair(temperature, std::make_pair(file->second, pageNo)));
+  }
+
+  // keep the hottest, then read them in file and page order
+  const std::uint32_t limit = std::min<std::uint32_t>(maxPages != 0 ? maxPages : numBufs / 2, numBufs);
+  std::stable_sort(listed.begin(), listed.end(),
+                   [](const std::pair<std::uint32_t, std::pair<File*, PageId> >& a,
+                      const std::pair<std::uint32_t, std::pair<File*, PageId> >& b) { return a.first > b.first; });
+  if (listed.size() > limit)
+    listed.resize(limit);
+
+  std::map<std::pair<File*, PageId>, std::uint32_t> pages;
+  for (std::size_t i = 0; i < listed.size(); i++)
+    pages[listed[i].second] = listed[i].first;
+
+  std::uint32_t loaded = 0;
+  std::map<std::pair<File*, PageId>, std::uint32_t>::const_iterator it = pages.begin();
+  while (it != pages.end())
+  {
+    // one batch of pages of the same file
+    File* file = it->first.first;
+    std::vector<PageId> pageNos;
+    std::vector<std::uint32_t> temperatures;
+    for (; it != pages.end() && it->first.first == file && pageNos.size() < WARM_UP_BATCH; ++it)
+    {
+      pageNos.push_back(it->first.second);
+      temperatures.push_back(it->second);
+    }
+
+    std::vector<Page*> batch;
+    try
+    {
+      readPages(file, pageNos, batch);
+    }
+    catch (...)
+    {
+      // some page is gone or the pool is busy; load the batch page by page
+      batch.assign(pageNos.size(), NULL);
+      for (std::size_t i = 0; i < pageNos.size(); i++)
+      {
+        try
+        {
+          readPage(file, pageNos[i], batch[i]);
+        }
+        catch (...)
+        {
+        }
+      }
+    }
+
+    for (std::size_t i = 0; i < pageNos.size(); i++)
+    {
+      if (batch[i] == NULL)
+        continue;
+      const FrameId frameNo = batch[i] - bufPool;
+      accessCounts[frameNo] = std::max(accessCounts[frameNo].load(), temperatures[i]);
+      unPinPage(file, pageNos[i], false);
+      loaded++;
+    }
+  }
+  return loaded;
+}
+
+void BufMgr::clearBufStats()
+{
+  bufStats.clear();
+  for (std::uint32_t i = 0; i < NUM_PARTITIONS; i++)
+  {
+    std::lock_guard<std::mutex> guard(partitionLatch[i]);
+    fileStats[i].clear();
+    flushedFileStats[i].clear();
+  }
+}
+
+void BufMgr::retireFileStats(const File* file)
+{
+  for (std::uint32_t i = 0; i < NUM_PARTITIONS; i++)
+  {
+    std::lock_guard<std::mutex> guard(partitionLatch[i]);
+    std::map<const File*, OpenFileStats>::iterator entry = fileStats[i].find(file);
+    if (entry == fileStats[i].end())
+      continue;
+    flushedFileStats[i][entry->second.name] += entry->second.counts;
+    fileStats[i].erase(entry);
+  }
+}
+
+BufStatsSnapshot BufMgr::statsSnapshot()
+{
+  BufStatsSnapshot snapshot;
+  snapshot.policy = policy->name();
+  snapshot.poolSize = numBufs;
+  snapshot.victimCacheBytes = victimCache.bytesUsed();
+  snapshot.totals = bufStats;
+
+  // a file's counters are spread over the partitions its pages hash to
+  for (std::uint32_t i = 0; i < NUM_PARTITIONS; i++)
+  {
+    std::lock_guard<std::mutex> guard(partitionLatch[i]);
+    for (std::map<const File*, OpenFileStats>::const_iterator it = fileStats[i].begin(); it != fileStats[i].end(); ++it)
+      snapshot.files[it->second.name] += it->second.counts;
+    for (std::map<std::string, FileStats>::const_iterator it = flushedFileStats[i].begin();
+         it != flushedFileStats[i].end(); ++it)
+      snapshot.files[it->first] += it->second;
+  }
+  return snapshot;
+}
+
+void BufMgr::dumpStats(const std::string& filename)
+{
+  std::ofstream out;
+  out.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+  out.open(filename.c_str(), std::ofstream::out | std::ofstream::trunc);
+  dumpStats(out);
 }
 
 void BufMgr::printSelf(void) 
@@ -238,9 +1786,9 @@ void BufMgr::printSelf(void)
 	{
   	tmpbuf = &(bufDescTable[i]);
 		std::cout << "FrameNo:" << i << " ";
-		tmpbuf->Print();
+		tmpbuf->Print(validBits.test(i), pinCounts[i], dirtyBits.test(i));
 
-  	if (tmpbuf->valid == true)
+  	if (validBits.test(i))
     	validFrames++;
   }
 
@@ -9,7 +9,23 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "buf_stats.h"
+#include "frame_state.h"
+#include "io_ring.h"
+#include "page_cache.h"
+#include "replacement_policy.h"
+#include "wal.h"
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace badgerdb {
 
@@ -20,6 +36,12 @@ class BufMgr;
 
 /**
 * @brief Class for maintaining information about buffer pool frames
+*
+* The page a frame holds (file, pageNo) is only changed by the thread that
+* owns the frame, and only while it holds the page table partition latch of
+* that page.  The state the clock sweep tests on every step (pin count, valid
+* and dirty) is not kept here but in dense per frame arrays of BufMgr, so
+* that a sweep does not have to touch the descriptors.
 */
 class BufDesc {
 
@@ -29,12 +51,12 @@ class BufDesc {
 	/**
    * Pointer to file to which corresponding frame is assigned
 	 */
-  File* file;
+  std::atomic<File*> file;
 
 	/**
    * Page within file to which corresponding frame is assigned
 	 */
-  PageId pageNo;
+  std::atomic<PageId> pageNo;
 
 	/**
    * Frame number of the frame, in the buffer pool, being used
@@ -42,36 +64,27 @@ class BufDesc {
   FrameId	frameNo;
 
 	/**
-   * Number of times this page has been pinned
+   * True while the page is being read into the frame, or written out of it.
+   * Threads which pin the frame in the meantime wait for the I/O to complete,
+   * so that they neither see a partly read page nor change one being written.
 	 */
-  int pinCnt;
+  std::atomic<bool> ioPending;
 
 	/**
-   * True if page is dirty;  false otherwise
+   * True while the frame is being evicted by the clock; the pin held by the
+   * evicting thread is not a user pin.
 	 */
-  bool dirty;
-
-	/**
-   * True if page is valid
-	 */
-  bool valid;
-
-	/**
-   * Has this buffer frame been reference recently
-	 */
-  bool refbit;
+  std::atomic<bool> evicting;
 
 	/**
    * Initialize buffer frame for a new user
 	 */
   void Clear()
 	{
-    pinCnt = 0;
 		file = NULL;
 		pageNo = Page::INVALID_NUMBER;
-    dirty = false;
-    refbit = false;
-		valid = false;
+    ioPending = false;
+    evicting = false;
   };
 
 	/**
@@ -85,17 +98,22 @@ class BufDesc {
 	{ 
 		file = filePtr;
     pageNo = pageNum;
-    pinCnt = 1;
-    dirty = false;
-    valid = true;
-    refbit = true;
+    evicting = false;
   }
 
-  void Print()
+	/**
+	 * Print the frame, given its state kept by BufMgr.
+	 *
+	 * @param valid 	True if the frame holds a page
+	 * @param pinCnt	Pin count of the frame
+	 * @param dirty 	True if the page is dirty
+	 */
+  void Print(const bool valid, const int pinCnt, const bool dirty)
 	{
-		if(file != NULL)
+		File* filePtr = file;
+		if(filePtr != NULL)
 		{
-			std::cout << "file:" << file->filename() << " ";
+			std::cout << "file:" << filePtr->filename() << " ";
 			std::cout << "pageNo:" << pageNo << " ";
 		}
 		else
@@ -103,8 +121,7 @@ class BufDesc {
 
 		std::cout << "valid:" << valid << " ";
 		std::cout << "pinCnt:" << pinCnt << " ";
-		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
+		std::cout << "dirty:" << dirty << "\n";
   }
 
 	/**
@@ -118,58 +135,203 @@ class BufDesc {
 
 
 /**
-* @brief Class to maintain statistics of buffer usage 
+* @brief Classes of files sharing the buffer pool under separate quotas (BufMgr::setClassQuota())
+*/
+enum BufferClass
+{
+	HEAP_CLASS = 0,
+	INDEX_CLASS = 1,
+	TEMP_CLASS = 2
+};
+
+/**
+* Number of buffer classes
+*/
+static const std::uint32_t NUM_BUFFER_CLASSES = 3;
+
+
+/**
+* @brief Access strategy keeping a sequential reader to a small ring of frames
+*
+* A reader passing a strategy to BufMgr::readPage() has its misses served from
+* the frames it used itself a ring length ago, as long as those still hold the
+* page it left there and are unpinned.  A full relation scan therefore only
+* ever occupies a ring's worth of the pool instead of evicting everybody
+* else's pages.  Only when a ring frame cannot be reused is a frame taken from
+* the pool as usual; it then replaces the old one in the ring.
+*
+* A strategy belongs to one reader.  The reader may also hand it to
+* BufMgr::prefetchChain(), so that pages read ahead land in its ring; the
+* strategy must then outlive those prefetches, which BufMgr::flushFile() of
+* the file waits for.
 */
-struct BufStats
+class BufferAccessStrategy
 {
+	friend class BufMgr;
+
+ public:
 	/**
-   * Total number of accesses to buffer pool
+   * Constructor of BufferAccessStrategy class
+	 *
+	 * @param ringSize  Number of frames in the ring
 	 */
-  int accesses;
+  BufferAccessStrategy(const std::uint32_t ringSize)
+		: slots(ringSize), current(0)
+  {
+  }
 
+ private:
 	/**
-   * Number of pages read from disk (including allocs)
+   * Guards the ring against the reader and the prefetcher using it at the same time
 	 */
-  int diskreads;
+  std::mutex latch;
 
 	/**
-   * Number of pages written back to disk
+	 * @brief A ring frame and the page the owner last read into it
 	 */
-  int diskwrites;
+  struct Slot {
+		Slot() : frameNo(0), file(NULL), pageNo(Page::INVALID_NUMBER) {}
+
+		FrameId frameNo;
+		File* file;
+		PageId pageNo;
+  };
 
 	/**
-   * Clear all values 
+   * Ring of frames, in order of use
 	 */
-  void clear()
-  {
-		accesses = diskreads = diskwrites = 0;
-  }
-      
+  std::vector<Slot> slots;
+
 	/**
-   * Constructor of BufStats class 
+   * Slot to be used by the next miss
 	 */
-  BufStats()
-  {
-		clear();
-  }
+  std::uint32_t current;
 };
 
 
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* BufMgr may be shared by several threads.  The page table is split into
+* NUM_PARTITIONS partitions, each guarded by its own latch; a pool hit only
+* takes the latch of the partition its page hashes to.  Pin counts are atomic,
+* so any number of threads may look for victims at the same time.  No latch
+* is held while a page is read or written, so misses on different pages go
+* to disk in parallel.
+*
+* Which page is given up when a frame is needed is decided by the
+* ReplacementPolicy chosen at construction.
+*
+* An optional background writer thread (startBackgroundWriter()) writes out
+* dirty pages the policy is about to evict, so that threads missing in the
+* pool find clean victims and do not pay for somebody else's write.
+*
+* Files may be put in classes (heap, index, temporary) with a minimum and
+* maximum number of frames each (setClassQuota()), so that, say, a bulk load
+* of a heap file cannot take the frames of the indexes.
+*
+* Clean pages evicted from the pool may be kept compressed in a second tier
+* victim cache (setVictimCacheSize()), from which a later miss on them is
+* served without a disk read.
+*
+* Readers following a chain of pages may ask for the next pages in advance
+* (prefetchChain()); a prefetch thread then reads them while the reader is
+* still busy with the current one, putting the next page of every queued chain
+* in flight at once on an IoRing.
+*
+* With a WriteAheadLog attached (setLog()), every page unpinned dirty is
+* logged, and commit() makes all changes so far durable with a single sync of
+* the log however many threads commit at once.  Dirty pages are still only
+* written to their files when they are evicted or flushed, after the log has
+* been flushed past them.
+*
+* Checkpoints (checkpoint(), or periodically with startCheckpointer()) write
+* the dirty pages a batch at a time while the pool stays in use, sync the
+* files written, and drop the log records no longer needed, so that redo
+* after a crash only has to replay what was logged since.
 */
 class BufMgr 
 {
+ public:
+	/**
+   * Number of independently latched page table partitions
+	 */
+  static const std::uint32_t NUM_PARTITIONS = 16;
+
+	/**
+   * Number of pages scans read ahead unless changed by setReadAhead()
+	 */
+  static const std::uint32_t DEFAULT_READ_AHEAD = 4;
+
+	/**
+   * Unless given, the pool may grow to this many times its initial size
+	 */
+  static const std::uint32_t DEFAULT_GROWTH = 4;
+
+	/**
+   * Most pages warmUp() reads with one readPages() call
+	 */
+  static const std::uint32_t WARM_UP_BATCH = 64;
+
+	/**
+   * Most reads readPages() and the prefetch thread keep in flight at once
+	 */
+  static const std::uint32_t IO_RING_DEPTH = 64;
+
+	/**
+   * Most consecutive pages readPages() reads with one request
+	 */
+  static const std::size_t IO_RUN_PAGES = 32;
+
+	/**
+   * Most prefetch requests the prefetch thread reads at once
+	 */
+  static const std::size_t PREFETCH_BATCH = 16;
+
+	/**
+   * Number of frames checkpoint() looks at, and writes the dirty pages of, at a time
+	 */
+  static const std::uint32_t CHECKPOINT_BATCH = 64;
+
+	/**
+   * Returns the number of the page following the given one in a chain of pages, or Page::INVALID_NUMBER
+	 */
+  typedef std::function<PageId(const Page&)> NextPageFn;
+
  private:
 	/**
-   * Current position of clockhand in our buffer pool
+	 * @brief A chain of pages to be read ahead
+	 */
+  struct PrefetchRequest {
+		File* file;
+		PageId pageNo;
+		std::uint32_t depth;
+		NextPageFn next;
+		BufferAccessStrategy* strategy;
+  };
+
+	/**
+	 * @brief Usage counters of an open file, with the name they are reported under
 	 */
-  FrameId clockHand;
+  struct OpenFileStats {
+		std::string name;
+		FileStats counts;
+  };
 
 	/**
    * Number of frames in the buffer pool
 	 */
-  std::uint32_t numBufs;
+  std::atomic<std::uint32_t> numBufs;
+
+	/**
+   * Number of frames the pool can be resized to at most; per frame state is allocated for this many
+	 */
+  const std::uint32_t maxBufs;
+
+	/**
+   * Serializes resize()
+	 */
+  std::mutex resizeLatch;
 	
 	/**
    * Hash table mapping (File, page) to frame
@@ -181,38 +343,637 @@ class BufMgr
 	 */
   BufDesc *bufDescTable;
 
+	/**
+   * Per frame: true if the frame holds a page
+	 */
+  FrameBitset validBits;
+
+	/**
+   * Per frame: true if the page has been modified since it was read or written
+	 */
+  FrameBitset dirtyBits;
+
+	/**
+   * Per frame: number of times the page has been pinned, cache line aligned
+	 */
+  std::atomic<int>* pinCounts;
+
+	/**
+   * Per frame: buffer class of the file of the page held
+	 */
+  std::atomic<std::uint8_t>* frameClasses;
+
+	/**
+   * Per buffer class: number of frames holding its pages, and its minimum and maximum number of frames
+	 */
+  std::atomic<std::uint32_t> classFrames[NUM_BUFFER_CLASSES];
+  std::atomic<std::uint32_t> classMin[NUM_BUFFER_CLASSES];
+  std::atomic<std::uint32_t> classMax[NUM_BUFFER_CLASSES];
+
+	/**
+   * True once any quota has been set; until then victims are chosen without looking at classes
+	 */
+  std::atomic<bool> quotasSet;
+
+	/**
+   * Buffer class of each file not in HEAP_CLASS
+	 */
+  std::map<const File*, BufferClass> fileClasses;
+
+	/**
+   * Protects fileClasses
+	 */
+  std::mutex fileClassesLatch;
+
+	/**
+   * Per frame: number of hits on the page since it was loaded, its temperature for dumpResidentPages()
+	 */
+  std::atomic<std::uint32_t>* accessCounts;
+
+	/**
+   * Per frame: LSN the log must be flushed to before the page may be written to its file
+	 */
+  std::atomic<Lsn>* pageLsns;
+
+	/**
+   * Log the changes of pages are written to first, NULL if not logging
+	 */
+  WriteAheadLog* log;
+
+	/**
+   * Files which had pages allocated or deleted since the last commit(), and the latch protecting them
+	 */
+  std::set<const File*> restructuredFiles;
+  std::mutex restructuredLatch;
+
+	/**
+   * Files with pages written since they were last synced; only kept with a log
+	 */
+  std::set<const File*> unsyncedFiles;
+
+	/**
+   * Number of evictions between taking a page's dirty bit and noting its write in unsyncedFiles, and whether a
+   * checkpoint keeps new ones from starting; protected by pageWriteLatch, pageWritesDone is signalled when the
+   * last one ends or the checkpoint is done
+	 */
+  std::uint32_t pageWritesInFlight;
+  bool checkpointFence;
+  std::mutex pageWriteLatch;
+  std::condition_variable pageWritesDone;
+
+	/**
+   * Serializes checkpoint()
+	 */
+  std::mutex checkpointLatch;
+
+	/**
+   * Checkpoint thread, NULL if not running; it checkpoints every checkpointInterval milliseconds
+	 */
+  std::thread* checkpointThread;
+  std::atomic<bool> checkpointRunning;
+  std::uint32_t checkpointInterval;
+
+	/**
+   * Mutex and condition the checkpoint thread sleeps on
+	 */
+  std::mutex checkpointSleepLatch;
+  std::condition_variable checkpointWakeup;
+
 	/**
    * Maintains Buffer pool usage statistics 
 	 */
   BufStats bufStats;
 
 	/**
+   * Compressed images of clean pages evicted from the pool; disabled unless setVictimCacheSize() is called
+	 */
+  CompressedPageCache victimCache;
+
+	/**
+   * Page replacement policy choosing victims for allocBuf()
+	 */
+  ReplacementPolicy* policy;
+
+	/**
+   * Passes frames which are currently evictable (unpinned) to the policy
+	 */
+  ReplacementPolicy::FrameFilter evictable;
+
+	/**
+   * Passes frames which are evictable without a write (unpinned and clean) to the policy
+	 */
+  ReplacementPolicy::FrameFilter evictableClean;
+
+	/**
+   * Background writer thread, NULL if not running
+	 */
+  std::thread* writerThread;
+
+	/**
+   * Tells the background writer to keep running
+	 */
+  std::atomic<bool> writerRunning;
+
+	/**
+   * Number of upcoming victims the background writer keeps clean
+	 */
+  std::uint32_t writerCleanTarget;
+
+	/**
+   * Milliseconds the background writer sleeps between rounds
+	 */
+  std::uint32_t writerInterval;
+
+	/**
+   * Mutex and condition the background writer sleeps on
+	 */
+  std::mutex writerSleepLatch;
+  std::condition_variable writerWakeup;
+
+	/**
+   * Held by the background writer while it has pages pinned for writing, and by flushFile() and
+   * disposePage(), which must not mistake those pins for pins of the file's users
+	 */
+  std::mutex writerBatchLatch;
+
+	/**
+   * Number of pages scans read ahead
+	 */
+  std::atomic<std::uint32_t> readAheadDepth;
+
+	/**
+   * Prefetch thread, NULL until the first prefetch
+	 */
+  std::thread* prefetchThread;
+
+	/**
+   * Pending prefetches, next first
+	 */
+  std::deque<PrefetchRequest> prefetchQueue;
+
+	/**
+   * Files of the batch of prefetches being worked on, once per request
+	 */
+  std::multiset<const File*> prefetchInFlight;
+
+	/**
+   * Files whose prefetches in progress have been cancelled, so the rest of their chains is dropped
+	 */
+  std::set<const File*> prefetchCancelled;
+
+	/**
+   * Tells the prefetch thread to exit
+	 */
+  bool prefetchStopping;
+
+	/**
+   * Protects the prefetch members above; the prefetch thread waits for requests on prefetchWakeup, and
+   * flushFile() for a prefetch of its file to finish on prefetchDone
+	 */
+  std::mutex prefetchLatch;
+  std::condition_variable prefetchWakeup;
+  std::condition_variable prefetchDone;
+
+	/**
+   * Resident pages of each file, in page order
+	 */
+  typedef std::map<const File*, std::set<PageId> > FilePageMap;
+  FilePageMap filePages;
+
+	/**
+   * Protects filePages; taken while holding a partition latch
+	 */
+  std::mutex filePagesLatch;
+
+	/**
+   * Serializes allocPage() and disposePage(), so that the links of resident pages are changed in the same order as
+   * on disk
+	 */
+  std::mutex pageListLatch;
+
+	/**
+   * Latches guarding the page table partitions
+	 */
+  std::mutex partitionLatch[NUM_PARTITIONS];
+
+	/**
+   * Usage counters of each open file, by File object, kept per page table partition and guarded by its latch, so
+   * that counting a hit takes no lock besides the one already held
+	 */
+  std::map<const File*, OpenFileStats> fileStats[NUM_PARTITIONS];
+
+	/**
+   * Usage counters of files flushed since, by file name, per partition like fileStats; flushFile() moves a file's
+   * counters here, as the file may be closed and another one opened at its address
+	 */
+  std::map<std::string, FileStats> flushedFileStats[NUM_PARTITIONS];
+
+	/**
+   * Milliseconds allocBuf() waits for a frame to be unpinned when all are pinned; 0 to fail at once
+	 */
+  std::atomic<std::uint32_t> allocTimeout;
+
+	/**
+   * Number of threads waiting in allocBuf() for a frame to be unpinned
+	 */
+  std::atomic<std::uint32_t> allocWaiters;
+
+	/**
+   * Advanced each time a frame is unpinned while threads are waiting for one; they wait on frameReleased for it to
+   * change.  Protected by allocWaitLatch.
+	 */
+  std::uint64_t unpinGeneration;
+  std::mutex allocWaitLatch;
+  std::condition_variable frameReleased;
+
+	/**
+   * Mutex and condition used to wait for a pending page read to complete
+	 */
+  std::mutex ioWaitLatch;
+  std::condition_variable ioComplete;
+
+	/**
+   * Rings not in use by a readPages() call, and whether new rings may use io_uring; protected by ringLatch
+	 */
+  std::vector<IoRing*> idleRings;
+  bool kernelRings;
+  std::mutex ringLatch;
+
+	/**
 	 * Allocate a free frame.  
+	 * The frame is returned pinned once by the caller and not mapped to any page.
+	 * Victims are chosen within the quotas of the buffer classes if possible.  If all frames are pinned, waits up to
+	 * the allocation timeout for one to be unpinned.
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param file   	File the frame is for
+	 * @param strategy	Access strategy whose ring is tried first, or NULL
 	 * @throws BufferExceededException If no such buffer is found which can be allocated
 	 */
-  void allocBuf(FrameId & frame);
+  void allocBuf(FrameId & frame, const File* file, BufferAccessStrategy* strategy = NULL);
+
+	/**
+	 * Finds and evicts a victim, within the quotas of the buffer classes if possible.
+	 *
+	 * @param frame   	Evicted frame, pinned once and invalid, returned via this variable
+	 * @param file   	File the frame is for
+	 * @return  False if every frame is pinned.
+	 */
+  bool chooseVictim(FrameId& frame, const File* file);
+
+	/**
+	 * Retries chooseVictim() each time a frame is unpinned, until it succeeds or the deadline passes.
+	 *
+	 * @param frame   	Evicted frame, pinned once and invalid, returned via this variable
+	 * @param file   	File the frame is for
+	 * @param deadline	Time to give up at
+	 * @return  False if no frame became available in time.
+	 */
+  bool waitForVictim(FrameId& frame, const File* file, const LatencyHistogram::Clock::time_point deadline);
+
+	/**
+	 * Wakes the threads waiting in waitForVictim().
+	 */
+  void notifyFrameReleased();
+
+	/**
+	 * Drops a pin held on a frame, waking threads waiting for a frame if it is now unpinned.
+	 *
+	 * @param frameNo	Frame
+	 */
+  void unpinFrame(const FrameId frameNo)
+  {
+		if (--pinCounts[frameNo] == 0 && allocWaiters > 0)
+			notifyFrameReleased();
+  }
+
+	/**
+	 * Asks the policy for victims passing the given filters until one can be evicted.  With a background writer
+	 * running, clean victims are tried first.
+	 *
+	 * @param frame   	Evicted frame, pinned once and invalid, returned via this variable
+	 * @param clean   	Filter for victims needing no write
+	 * @param any     	Filter for all acceptable victims
+	 * @return  False if no acceptable victim could be evicted.
+	 */
+  bool takeVictim(FrameId& frame, const ReplacementPolicy::FrameFilter& clean,
+                  const ReplacementPolicy::FrameFilter& any);
+
+	/**
+	 * Returns true if the quotas allow a page of the given class to replace the page in the frame: a class at its
+	 * maximum only replaces its own pages, and a class at or below its minimum only loses pages to itself.
+	 *
+	 * @param requester	Buffer class of the page to be read
+	 * @param frameNo 	Candidate victim frame
+	 */
+  bool quotaAllows(const BufferClass requester, const FrameId frameNo) const;
+
+	/**
+	 * Returns the buffer class of the file.
+	 *
+	 * @param file   	File object
+	 */
+  BufferClass classOf(const File* file);
+
+	/**
+	 * Marks a frame owned by the caller as no longer holding a page, and takes it off its class.
+	 *
+	 * @param frameNo	Frame
+	 */
+  void invalidateFrame(const FrameId frameNo)
+  {
+		if (validBits.test(frameNo))
+		{
+			validBits.reset(frameNo);
+			classFrames[frameClasses[frameNo]]--;
+		}
+  }
+
+	/**
+	 * Try to take the frame away from the page it currently holds.  Succeeds only if the frame is not pinned;
+	 * a dirty page is written back before it is removed from the page table.
+	 *
+	 * @param frameNo	Frame to evict
+	 * @param onlyFile	If not NULL, the frame is only evicted if it is free or still holds (onlyFile, onlyPage)
+	 * @param onlyPage	See onlyFile
+	 * @return  True if the frame is now owned by the caller (pinned once and invalid).
+	 */
+  bool evictFrame(const FrameId frameNo, const File* onlyFile = NULL,
+                  const PageId onlyPage = Page::INVALID_NUMBER);
+
+	/**
+	 * Returns the latch of the page table partition holding the given page.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  std::mutex& latchFor(const File* file, const PageId pageNo)
+  {
+		return partitionLatch[hashTable->partition(file, pageNo)];
+  }
+
+	/**
+	 * Returns the usage counters of the file in the page table partition of the given page.  The caller holds that
+	 * partition's latch.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  FileStats& fileStatsFor(const File* file, const PageId pageNo)
+  {
+		std::map<const File*, OpenFileStats>& stats = fileStats[hashTable->partition(file, pageNo)];
+		std::map<const File*, OpenFileStats>::iterator entry = stats.find(file);
+		if (entry == stats.end())
+		{
+			entry = stats.insert(std::make_pair(file, OpenFileStats())).first;
+			entry->second.name = file->filename();
+		}
+		return entry->second.counts;
+  }
+
+	/**
+	 * Moves the usage counters of the file to flushedFileStats.
+	 *
+	 * @param file   	File object
+	 */
+  void retireFileStats(const File* file);
+
+	/**
+	 * Look the page up in the page table and pin its frame if present.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frameNo Frame holding the page, returned via this variable
+	 * @return  True if the page is resident.
+	 */
+  bool pinResident(File* file, const PageId pageNo, FrameId& frameNo, const bool accessed = true);
+
+	/**
+	 * Assigns a frame owned by the caller to a page, pinned once and clean.
+	 *
+	 * @param frameNo	Frame
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  void setFrame(const FrameId frameNo, File* file, const PageId pageNo)
+  {
+		bufDescTable[frameNo].Set(file, pageNo);
+		pinCounts[frameNo] = 1;
+		accessCounts[frameNo] = 0;
+		// a later LSN left by the page held before would let a checkpoint drop the records of this one
+		pageLsns[frameNo] = 0;
+		dirtyBits.reset(frameNo);
+		const BufferClass bufferClass = classOf(file);
+		frameClasses[frameNo] = bufferClass;
+		classFrames[bufferClass]++;
+		validBits.set(frameNo);
+  }
+
+	/**
+	 * Resets a frame owned by the caller to hold no page and be unpinned.
+	 *
+	 * @param frameNo	Frame
+	 */
+  void clearFrame(const FrameId frameNo)
+  {
+		bufDescTable[frameNo].Clear();
+		dirtyBits.reset(frameNo);
+		invalidateFrame(frameNo);
+		pinCounts[frameNo] = 0;
+		accessCounts[frameNo] = 0;
+		pageLsns[frameNo] = 0;
+		if (allocWaiters > 0)
+			notifyFrameReleased();
+  }
+
+	/**
+	 * Enters the page in the page table and in the resident pages of its file.  The caller holds the page's
+	 * partition latch.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frameNo Frame holding the page
+	 */
+  void mapPage(File* file, const PageId pageNo, const FrameId frameNo);
+
+	/**
+	 * Removes the page from the page table and from the resident pages of its file.  The caller holds the page's
+	 * partition latch.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  void unmapPage(const File* file, const PageId pageNo);
+
+	/**
+	 * Brings a page list link of a page up to date with its file after a page next to it has been allocated or
+	 * deleted: a resident copy has the link set, once any read of it in flight has completed, and a copy in the
+	 * victim cache is dropped.  Callers hold pageListLatch.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file; Page::INVALID_NUMBER does nothing
+	 * @param next  	True to set the next page number, false to set the previous one
+	 * @param linked	Page number the link now holds
+	 */
+  void refreshLink(File* file, const PageId pageNo, const bool next, const PageId linked);
+
+	/**
+	 * Maps the page to a frame just taken by allocBuf(), unless another thread has mapped it in the meantime.
+	 * A newly mapped page is left with its read pending for the caller to do.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param newFrame	Frame from allocBuf(); released again if the page is already mapped
+	 * @param frameNo Frame holding the page, pinned once for the caller, returned via this variable
+	 * @param accessed	False if the page is only being read ahead
+	 * @return  True if the page was mapped to newFrame and must be read by the caller.
+	 */
+  bool installPage(File* file, const PageId pageNo, const FrameId newFrame, FrameId& frameNo, const bool accessed);
+
+	/**
+	 * Pins the given page, reading it into a frame if it is not resident.  Does the work of readPage().
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param strategy	Access strategy of a sequential reader, or NULL
+	 * @param accessed	False if the page is only being read ahead, which the policy does not count as a reference
+	 * @return  Frame holding the page, pinned once for the caller.
+	 */
+  FrameId fetchPage(File* file, const PageId pageNo, BufferAccessStrategy* strategy, const bool accessed);
+
+	/**
+	 * Main loop of the prefetch thread.
+	 */
+  void prefetchLoop();
+
+	/**
+	 * Reads the next page of each of a batch of prefetch requests, all of them in flight at once on an IoRing, and
+	 * returns the requests for the rest of their chains.
+	 *
+	 * @param batch	Prefetch requests; on return, the requests for their next pages, with depth 0 if there is none
+	 */
+  void prefetchBatch(std::vector<PrefetchRequest>& batch);
+
+	/**
+	 * Gives the frame a page has just been loaded into the current place in the ring of an access strategy.
+	 *
+	 * @param strategy	Access strategy of the reader, or NULL
+	 * @param frameNo	Frame the page was loaded into
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 */
+  void takeRingSlot(BufferAccessStrategy* strategy, const FrameId frameNo, File* file, const PageId pageNo);
+
+	/**
+	 * Drops pending prefetches of the file and waits for one in progress to finish.
+	 *
+	 * @param file   	File object
+	 */
+  void cancelPrefetches(const File* file);
+
+	/**
+	 * Main loop of the background writer thread.
+	 */
+  void backgroundWriterLoop();
+
+	/**
+	 * Writes out the dirty pages among the policy's upcoming victims, in file and page order.
+	 *
+	 * @return  Number of pages written.
+	 */
+  std::uint32_t writeUpcomingVictims();
+
+	/**
+	 * Writes out the given frames which hold a dirty page, in file and page order.  Frames pinned by other threads
+	 * are skipped; threads pinning a frame while it is written wait for the write.  Callers hold writerBatchLatch.
+	 *
+	 * @param frames  	Frames to look at
+	 * @return  Number of pages written.
+	 */
+  std::uint32_t writeFrames(const std::vector<FrameId>& frames);
+
+	/**
+	 * Main loop of the checkpoint thread.
+	 */
+  void checkpointLoop();
+
+	/**
+	 * Marks the start of the eviction of a dirty page; waits while a checkpoint looks at the pool.
+	 */
+  void beginPageWrite();
+
+	/**
+	 * Marks the end of an eviction started with beginPageWrite().
+	 *
+	 * @param written  	File the page was written to, NULL if it was not written
+	 */
+  void endPageWrite(const File* written);
+
+	/**
+	 * Notes that a page of the file has been written and the file needs a sync before the log records of the page
+	 * may be dropped.
+	 */
+  void fileWritten(const File* file)
+  {
+    if (log == NULL)
+      return;
+    std::lock_guard<std::mutex> lock(pageWriteLatch);
+    unsyncedFiles.insert(file);
+  }
+
+	/**
+	 * Block until any read or write pending on the given (pinned) frame has completed.
+	 *
+	 * @param frameNo	Frame to wait on
+	 * @return  False if the read failed and the frame no longer holds the page.
+	 */
+  bool waitForIo(const FrameId frameNo);
+
+	/**
+	 * Finish a read started by readPage(), or a write out of the frame, and release any waiters.  On failure of a
+	 * read the page is removed from the page table again and the frame is released.
+	 *
+	 * @param frameNo	Frame the page was read into or written out of
+	 * @param success	True if the read completed; always true for writes
+	 */
+  void completeIo(const FrameId frameNo, const bool success);
 
 	/**
-   * Advance clock to next frame in the buffer pool
+	 * Flushes the log, if any, past the last change to the page in the frame, so that the page may be written.
 	 */
-  void advanceClock()
+  void forceLog(const FrameId frameNo)
   {
-		clockHand = (clockHand + 1) % numBufs;
+    if (log != NULL)
+      log->flush(pageLsns[frameNo]);
   }
 
+	/**
+	 * Takes an idle ring, or sets up a new one.
+	 */
+  IoRing* acquireRing();
+
+	/**
+	 * Gives back a ring taken with acquireRing(); it must have nothing outstanding.
+	 */
+  void releaseRing(IoRing* ring);
+
 
  public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Actual buffer pool from which frames are allocated.  Address space for maxBufs frames is reserved up
+   * front, so the pool never moves when it is resized.
 	 */
   Page* bufPool;
 
 	/**
    * Constructor of BufMgr class
+	 *
+	 * @param bufs        Number of frames in the buffer pool
+	 * @param policyType  Page replacement policy to use; none of them locks on a hit (see ReplacementPolicyType)
+	 * @param bufsMax     Number of frames the pool may be resized to at most, 0 for DEFAULT_GROWTH times bufs
+	 * @throws BadPoolSizeException If bufs is 0
 	 */
-  BufMgr(std::uint32_t bufs);
+  BufMgr(std::uint32_t bufs, const ReplacementPolicyType policyType = CLOCK, std::uint32_t bufsMax = 0);
 	
 	/**
    * Destructor of BufMgr class
@@ -227,22 +988,52 @@ class BufMgr
 	 * @param file   	File object
 	 * @param PageNo  Page number in the file to be read
 	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param strategy	Access strategy of a sequential reader, or NULL to compete for the whole pool
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page,
+                BufferAccessStrategy* strategy = NULL);
+
+	/**
+	 * Reads several pages of a file into the buffer pool at once and pins each of them, as readPage() would.
+	 * The pages which are not resident are read straight into the frames, each run of consecutive pages (up to
+	 * IO_RUN_PAGES) with one vectored read, and the reads are all put in flight at once on an IoRing, up to
+	 * IO_RING_DEPTH at a time; a thread waiting for one of the pages goes on as soon as the read of its run
+	 * completes.  If any page cannot be read, none of them is left pinned.
+	 *
+	 * @param file   	File object
+	 * @param pageNos	Numbers of the pages to be read, in any order
+	 * @param pages  	Resized to hold a pointer to each page, in the order of pageNos
+	 * @throws BufferExceededException If the pool has not enough unpinned frames for the pages
+	 */
+  void readPages(File* file, const std::vector<PageId>& pageNos, std::vector<Page*>& pages);
+
+	/**
+	 * Chooses whether readPages() and the prefetch thread use io_uring when the kernel has it (the default) or read
+	 * synchronously.
+	 *
+	 * @param enabled	False to read synchronously
+	 */
+  void setAsyncIo(const bool enabled);
+
+	/**
+	 * Returns true if readPages() and the prefetch thread use io_uring when the kernel has it.
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+  bool asyncIo();
 
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
 	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number
-	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty; with a log, the page is then logged
    * @throws  PageNotPinnedException If the page is not already pinned
 	 */
   void unPinPage(File* file, const PageId PageNo, const bool dirty);
 
 	/**
 	 * Allocates a new, empty page in the file and returns the Page object.
-	 * The newly allocated page is also assigned a frame in the buffer pool.
+	 * The newly allocated page is also assigned a frame in the buffer pool.  The page it is appended after gets
+	 * its next page number updated in the pool as well as on disk.
 	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
@@ -251,9 +1042,10 @@ class BufMgr
   void allocPage(File* file, PageId &PageNo, Page*& page); 
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
+	 * Writes out all dirty pages of the file to disk and removes the file's pages from the buffer pool.
 	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
 	 * Otherwise Error returned.
+	 * Only the file's own pages are visited, in page order, and the file is synced once at the end.
 	 *
 	 * @param file   	File object
    * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
@@ -264,17 +1056,263 @@ class BufMgr
 	/**
 	 * Delete page from file and also from buffer pool if present.
 	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 * The pages before and after it in the file's page list get their links updated in the pool as well as on disk.
 	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number
+   * @throws  PagePinnedException If the page is pinned in the buffer pool
 	 */
   void disposePage(File* file, const PageId PageNo);
 
 	/**
+	 * Attaches a write-ahead log; from then on pages unpinned dirty are logged and commit() makes them durable.
+	 * Call this before any page is modified, after WriteAheadLog::redo() has recovered the files.  The log must
+	 * outlive the BufMgr.
+	 *
+	 * @param wal    	Log to attach, NULL to stop logging
+	 */
+  void setLog(WriteAheadLog* wal)
+  {
+    log = wal;
+  }
+
+	/**
+	 * Makes every change logged so far durable: syncs the files which had pages allocated or deleted since the
+	 * last commit, then flushes the log.  Threads committing while another one syncs the log wait for it and share
+	 * the next sync.  Pages themselves are not written.  Does nothing without a log.
+	 *
+   * @throws  FileIOException If a file or the log cannot be synced
+	 */
+  void commit();
+
+	/**
+	 * Takes a fuzzy checkpoint.  Dirty pages are written a batch of CHECKPOINT_BATCH frames at a time, without
+	 * stopping other threads from reading, pinning and unpinning pages; pages pinned meanwhile are left dirty.
+	 * Then the files written since their last sync are synced, and the log records which no page still needs are
+	 * dropped, so that redo starts at the oldest record of a page still dirty or at the start of the checkpoint.
+	 * Evictions wait only while the checkpoint looks at the dirty bits of the pool.  Does nothing without a log.
+	 *
+	 * @return  LSN redo of the log starts at from now on.
+   * @throws  FileIOException If a file or the log cannot be written
+	 */
+  Lsn checkpoint();
+
+	/**
+	 * Starts the checkpoint thread, which takes a checkpoint every intervalMs milliseconds.  Does nothing if it is
+	 * already running.
+	 *
+	 * @param intervalMs	Milliseconds between checkpoints
+	 */
+  void startCheckpointer(const std::uint32_t intervalMs);
+
+	/**
+	 * Stops the checkpoint thread and waits for it to exit.  Called by the destructor.
+	 */
+  void stopCheckpointer();
+
+	/**
+	 * Starts the background writer thread.  Every intervalMs milliseconds, or sooner when a thread had to evict a
+	 * dirty page itself, it asks the replacement policy for the next cleanTarget victims and writes out the dirty
+	 * ones in one sorted batch.  Does nothing if the writer is already running.
+	 *
+	 * @param cleanTarget	Number of upcoming victims to keep clean
+	 * @param intervalMs	Milliseconds between rounds
+	 */
+  void startBackgroundWriter(const std::uint32_t cleanTarget, const std::uint32_t intervalMs = 50);
+
+	/**
+	 * Stops the background writer thread and waits for it to exit.  Called by the destructor.
+	 */
+  void stopBackgroundWriter();
+
+	/**
+	 * Asks for pages to be read into the buffer pool in the background, starting with pageNo and following the chain
+	 * given by next for up to depth pages.  Pages are read unpinned and a request that cannot be served, e.g. because
+	 * the pool is full, is dropped.  flushFile() and disposePage() cancel pending prefetches of their file.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  First page to read
+	 * @param depth  	Number of pages to read
+	 * @param next  	Returns the page following a given one, may be empty if depth is 1
+	 * @param strategy	Access strategy of the reader the pages are for, or NULL
+	 */
+  void prefetchChain(File* file, const PageId pageNo, const std::uint32_t depth, const NextPageFn& next,
+                     BufferAccessStrategy* strategy = NULL);
+
+	/**
+	 * Keeps the read-ahead window of a scan readAhead() pages ahead of the page it is on.  The window starts out with
+	 * a chain read from the page after pageNo; cursor then tracks the last page of the window, moved along by the
+	 * prefetch thread as it finds those pages, so that each later call reads only the page following the cursor.
+	 * The cursor must be Page::INVALID_NUMBER when the scan starts and outlive the prefetches, like strategy.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page the scan is on
+	 * @param nextPageNo	Page following pageNo
+	 * @param cursor 	Last page of the window of the scan
+	 * @param next  	Returns the page following a given one
+	 * @param strategy	Access strategy of the scan, or NULL
+	 */
+  void readAheadFrom(File* file, const PageId pageNo, const PageId nextPageNo, std::atomic<PageId>& cursor,
+                     const NextPageFn& next, BufferAccessStrategy* strategy = NULL);
+
+	/**
+	 * Asks for a single page to be read into the buffer pool in the background.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page to read
+	 */
+  void prefetchPage(File* file, const PageId pageNo)
+  {
+		prefetchChain(file, pageNo, 1, NextPageFn());
+  }
+
+	/**
+	 * Sets the number of pages FileScan and BTreeIndex scans read ahead of the page they are on; 0 turns read-ahead off.
+	 */
+  void setReadAhead(const std::uint32_t depth)
+  {
+		readAheadDepth = depth;
+  }
+
+	/**
+	 * Returns the number of pages scans read ahead.
+	 */
+  std::uint32_t readAhead() const
+  {
+		return readAheadDepth;
+  }
+
+	/**
+	 * Grows or shrinks the buffer pool while it is in use.  New frames are added empty.  When shrinking, the pages in
+	 * the frames beyond the new size are written back if dirty and dropped, and the memory of those frames is
+	 * returned to the system; if one of them is pinned, the pool keeps its size.  The page table is resized in step.
+	 *
+	 * @param newBufs	New number of frames
+	 * @throws BadPoolSizeException If newBufs is 0 or larger than the maximum given at construction
+	 * @throws PagePinnedException If a page in a frame to be released is pinned
+	 */
+  void resize(const std::uint32_t newBufs);
+
+	/**
+	 * Writes the list of resident pages with their temperature (hits since the page was loaded) to the named file,
+	 * for warmUp() to reload them after a restart.  The file is written under a temporary name and renamed, so a dump
+	 * taken periodically never leaves a partial list behind.
+	 *
+	 * @param filename	Name of the file to write
+	 * @throws std::ios_base::failure If the file cannot be written
+	 */
+  void dumpResidentPages(const std::string& filename);
+
+	/**
+	 * Reloads pages listed by dumpResidentPages(), hottest first up to maxPages, reading them per file in page order
+	 * with batched readPages() calls.  Pages are left unpinned with their former temperature.  Pages of files not
+	 * among the given ones, and pages which no longer exist, are skipped.  A missing list warms nothing.
+	 *
+	 * @param filename	Name of the file written by dumpResidentPages()
+	 * @param files   	Open files whose pages may be reloaded, matched by file name
+	 * @param maxPages	Most pages to load; 0 for half the buffer pool
+	 * @return  Number of pages loaded.
+	 */
+  std::uint32_t warmUp(const std::string& filename, const std::vector<File*>& files,
+                       const std::uint32_t maxPages = 0);
+
+	/**
+   * Returns the number of frames in the buffer pool
+	 */
+  std::uint32_t poolSize() const
+  {
+		return numBufs;
+  }
+
+	/**
+   * Returns the number of frames the buffer pool can be resized to at most
+	 */
+  std::uint32_t maxPoolSize() const
+  {
+		return maxBufs;
+  }
+
+	/**
+	 * Sets how long a thread needing a frame waits for one to be unpinned when every frame is pinned, instead of
+	 * failing at once with BufferExceededException.  Waits are counted in BufStats.
+	 *
+	 * @param timeoutMs	Most milliseconds to wait; 0, the default, fails at once
+	 */
+  void setAllocWaitTimeout(const std::uint32_t timeoutMs)
+  {
+		allocTimeout = timeoutMs;
+  }
+
+	/**
+   * Returns how many milliseconds a thread waits for a frame to be unpinned when every frame is pinned
+	 */
+  std::uint32_t allocWaitTimeout() const
+  {
+		return allocTimeout;
+  }
+
+	/**
+	 * Puts the file in a buffer class; files are in HEAP_CLASS unless put elsewhere.  Pages already resident keep the
+	 * class they were read under.  A file in another class should be put back in HEAP_CLASS before it is closed.
+	 *
+	 * @param file   	File object
+	 * @param bufferClass	Buffer class of the file
+	 */
+  void setFileClass(const File* file, const BufferClass bufferClass);
+
+	/**
+	 * Sets the quota of a buffer class.  Pages of the class are not evicted for pages of other classes while it holds
+	 * minFrames frames or fewer; once it holds maxFrames frames, its pages only replace each other.  If the quotas
+	 * leave no victim for a page, any unpinned frame is taken, so a quota never makes a read fail.
+	 *
+	 * @param bufferClass	Buffer class
+	 * @param minFrames	Frames reserved for the class
+	 * @param maxFrames	Most frames the class may hold; raised to minFrames if lower
+	 */
+  void setClassQuota(const BufferClass bufferClass, const std::uint32_t minFrames, const std::uint32_t maxFrames);
+
+	/**
+	 * Returns the number of frames holding pages of the buffer class.
+	 *
+	 * @param bufferClass	Buffer class
+	 */
+  std::uint32_t framesInClass(const BufferClass bufferClass) const
+  {
+		return classFrames[bufferClass];
+  }
+
+	/**
+	 * Sets the memory given to the compressed victim cache, which holds evicted clean pages so that a later miss on them
+	 * is served without reading the file.  0, the default, disables the cache and drops the pages it holds.
+	 *
+	 * @param bytes	Most bytes of compressed page images to keep
+	 */
+  void setVictimCacheSize(const std::size_t bytes)
+  {
+		victimCache.setCapacity(bytes);
+  }
+
+	/**
+   * Returns the memory given to the compressed victim cache, in bytes
+	 */
+  std::size_t victimCacheSize() const
+  {
+		return victimCache.capacity();
+  }
+
+	/**
    * Print member variable values. 
 	 */
   void  printSelf();
 
+	/**
+   * Returns the name of the page replacement policy in use
+	 */
+  const char* policyName() const
+  {
+		return policy->name();
+  }
+
 	/**
    * Get buffer pool usage statistics
 	 */
@@ -284,12 +1322,33 @@ class BufMgr
   }
 
 	/**
-   * Clear buffer pool usage statistics
+   * Clear buffer pool usage statistics, including those of each file
+	 */
+  void clearBufStats();
+
+	/**
+	 * Returns a copy of the buffer pool usage statistics, with the counters of each file used since they were last
+	 * cleared.
 	 */
-  void clearBufStats() 
+  BufStatsSnapshot statsSnapshot();
+
+	/**
+	 * Writes a snapshot of the buffer pool usage statistics to the stream, in the format of BufStatsSnapshot::dump().
+	 *
+	 * @param out	Stream to write to
+	 */
+  void dumpStats(std::ostream& out)
   {
-		bufStats.clear();
+		statsSnapshot().dump(out);
   }
+
+	/**
+	 * Writes a snapshot of the buffer pool usage statistics to the named file, replacing its contents.
+	 *
+	 * @param filename	Name of the file to write
+	 * @throws std::ios_base::failure If the file cannot be written
+	 */
+  void dumpStats(const std::string& filename);
 };
 
 }
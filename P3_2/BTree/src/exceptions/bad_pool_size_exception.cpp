@@ -0,0 +1,22 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bad_pool_size_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+BadPoolSizeException::BadPoolSizeException(std::uint32_t requestedIn, std::uint32_t maximumIn)
+    : BadgerDbException(""), requested(requestedIn), maximum(maximumIn) {
+  std::stringstream ss;
+  ss << "Buffer pool size must be between 1 and " << maximum << " frames, requested: " << requested;
+  message_.assign(ss.str());
+}
+
+}
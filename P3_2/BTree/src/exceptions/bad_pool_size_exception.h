@@ -0,0 +1,39 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the buffer pool is asked to take a size it cannot have.
+ */
+class BadPoolSizeException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a bad pool size exception for the given requested and largest possible size.
+   */
+  explicit BadPoolSizeException(std::uint32_t requestedIn, std::uint32_t maximumIn);
+
+ protected:
+  /**
+   * Number of frames requested
+   */
+  const std::uint32_t requested;
+
+  /**
+   * Largest number of frames the pool can have
+   */
+  const std::uint32_t maximum;
+};
+
+}
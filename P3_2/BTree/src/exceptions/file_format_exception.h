@@ -0,0 +1,41 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a file being opened is not a
+ *        BadgerDB file or was written with another version of the file format.
+ */
+class FileFormatException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a file format exception for the given file.
+   *
+   * @param name  Name of file whose header was not recognized.
+   */
+  explicit FileFormatException(const std::string& name);
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+};
+
+}
@@ -0,0 +1,54 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the operating system reports an
+ *        error reading, writing or syncing a file.
+ */
+class FileIOException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a file I/O exception for the given file.
+   *
+   * @param name       Name of file the operation was on.
+   * @param operation  Operation which failed, e.g. "read".
+   * @param error      errno value reported for the operation.
+   */
+  FileIOException(const std::string& name, const std::string& operation,
+                  const int error);
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+  /**
+   * Returns the errno value reported for the operation.
+   */
+  virtual int error() const { return error_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+
+  /**
+   * errno value reported for the operation.
+   */
+  const int error_;
+};
+
+}
@@ -7,24 +7,39 @@
 
 #include "file.h"
 
-#include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
+#include <cerrno>
 #include <cassert>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_format_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "file_iterator.h"
+#include "io_ring.h"
 #include "page.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
+static const std::uint32_t FILE_MAGIC = 0x46474442;  // "BDGF"
+// Version 1 had neither the magic nor the last used page and the previous page
+// links of version 2.
+static const std::uint32_t FILE_VERSION = 2;
+
+File::DescriptorMap File::open_descriptors_;
 File::CountMap File::open_counts_;
+File::LatchMap File::open_latches_;
+File::HeaderMap File::open_headers_;
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -44,14 +59,7 @@ bool File::isOpen(const std::string& filename) {
 }
 
 bool File::exists(const std::string& filename) {
-	std::fstream file(filename);
-	if(file)
-	{
-		file.close();
-		return true;
-	}
-
-	return false;
+	return access(filename.c_str(), F_OK) == 0;
 }
 
 File::~File() {
@@ -64,13 +72,19 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
+PageId File::pageCount() const {
+  return readHeader().num_pages - 1;
+}
+
+File::File(const std::string& name, const bool create_new) : filename_(name), fd_(-1) {
   openIfNeeded(create_new);
 
   if (create_new) {
     // File starts with 1 page (the header).
-    FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+    FileHeader header = {FILE_MAGIC, FILE_VERSION,
+                         1 /* num_pages */, 0 /* first_used_page */,
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         0 /* last_used_page */};
     writeHeader(header);
   }
 }
@@ -78,10 +92,11 @@ File::File(const std::string& name, const bool create_new) : filename_(name) {
 void File::openIfNeeded(const bool create_new) {
   if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
     ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+    fd_ = open_descriptors_[filename_];
+    latch_ = open_latches_[filename_];
+    cached_header_ = open_headers_[filename_];
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
+    int flags = O_RDWR;
     const bool already_exists = exists(filename_);
     if (create_new) {
       // Error if we try to overwrite an existing file.
@@ -89,16 +104,39 @@ void File::openIfNeeded(const bool create_new) {
         throw FileExistsException(filename_);
       }
       // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
+      flags |= O_CREAT | O_TRUNC;
     } else {
       // Error if we try to open a file that doesn't exist.
       if (!already_exists) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
+    fd_ = ::open(filename_.c_str(), flags, 0666);
+    if (fd_ < 0) {
+      throw FileIOException(filename_, "open", errno);
+    }
+    FileHeader header;
+    if (!create_new) {
+      try {
+        File::readAt(&header, sizeof(FileHeader), 0 /* pos */);
+      } catch (...) {
+        ::close(fd_);
+        throw;
+      }
+      if (header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+        ::close(fd_);
+        throw FileFormatException(filename_);
+      }
+    }
+    open_descriptors_[filename_] = fd_;
     open_counts_[filename_] = 1;
+    latch_.reset(new std::recursive_mutex);
+    open_latches_[filename_] = latch_;
+    cached_header_.reset(new CachedHeader);
+    if (!create_new) {
+      storeHeader(header);
+    }
+    open_headers_[filename_] = cached_header_;
   }
 }
 
@@ -106,26 +144,150 @@ void File::close() {
 	if(open_counts_[filename_] > 0)
   	--open_counts_[filename_];
 
-  stream_.reset();
+  latch_.reset();
+  cached_header_.reset();
 	assert(open_counts_[filename_] >= 0);
 
   if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+    open_descriptors_.erase(filename_);
     open_counts_.erase(filename_);
+    open_latches_.erase(filename_);
+    open_headers_.erase(filename_);
   }
 }
 
 FileHeader File::readHeader() const {
   FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+  header.magic = FILE_MAGIC;
+  header.version = FILE_VERSION;
+  header.num_pages = cached_header_->num_pages;
+  header.first_used_page = cached_header_->first_used_page;
+  header.num_free_pages = cached_header_->num_free_pages;
+  header.first_free_page = cached_header_->first_free_page;
+  header.last_used_page = cached_header_->last_used_page;
   return header;
 }
 
+void File::storeHeader(const FileHeader& header) {
+  cached_header_->num_pages = header.num_pages;
+  cached_header_->first_used_page = header.first_used_page;
+  cached_header_->num_free_pages = header.num_free_pages;
+  cached_header_->first_free_page = header.first_free_page;
+  cached_header_->last_used_page = header.last_used_page;
+}
+
+void File::pageLinks(const PageId /* page_number */, PageId& prev_page_number,
+                     PageId& next_page_number) const {
+  prev_page_number = Page::INVALID_NUMBER;
+  next_page_number = Page::INVALID_NUMBER;
+}
+
+void File::sync() const {
+  if (fdatasync(fd_) != 0) {
+    throw FileIOException(filename_, "sync", errno);
+  }
+}
+
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
+  writeAt(&header, sizeof(FileHeader), 0 /* pos */);
+  storeHeader(header);
+}
+
+namespace {
+
+/**
+ * Reads or writes the given buffers at the given position of a descriptor,
+ * resuming after short transfers and interrupted calls.
+ *
+ * @return  Number of bytes not transferred because the end of the file was
+ *          reached; always 0 for writes.
+ */
+std::size_t transferAt(const int fd, const struct iovec* buffers, const int count,
+                       const off_t position, const bool write,
+                       const std::string& filename) {
+  std::size_t remaining = 0;
+  for (int i = 0; i < count; ++i) {
+    remaining += buffers[i].iov_len;
+  }
+
+  // Copy the buffers a batch at a time, so a short transfer can be resumed
+  // from the first buffer not yet done.
+  struct iovec vec[IOV_MAX];
+  int next = 0;
+  int vec_count = 0;
+  struct iovec* first = vec;
+  off_t offset = position;
+  while (remaining > 0) {
+    if (vec_count == 0) {
+      vec_count = std::min(count - next, (int) IOV_MAX);
+      std::copy(buffers + next, buffers + next + vec_count, vec);
+      next += vec_count;
+      first = vec;
+    }
+    const ssize_t done = write ? pwritev(fd, first, vec_count, offset)
+                               : preadv(fd, first, vec_count, offset);
+    if (done < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename, write ? "write" : "read", errno);
+    }
+    if (done == 0 && !write) {
+      return remaining;
+    }
+    remaining -= done;
+    offset += done;
+    std::size_t consumed = done;
+    while (vec_count > 0 && consumed >= first->iov_len) {
+      consumed -= first->iov_len;
+      ++first;
+      --vec_count;
+    }
+    if (vec_count > 0) {
+      first->iov_base = static_cast<char*>(first->iov_base) + consumed;
+      first->iov_len -= consumed;
+    }
+  }
+  return 0;
+}
+
+}
+
+void File::readAt(const struct iovec* buffers, const int count, const off_t position) const {
+  std::size_t missing = transferAt(fd_, buffers, count, position, false /* write */, filename_);
+  // Past the end of the file: the rest reads as zeros.
+  for (int i = count - 1; i >= 0 && missing > 0; --i) {
+    const std::size_t length = std::min(missing, buffers[i].iov_len);
+    memset(static_cast<char*>(buffers[i].iov_base) + buffers[i].iov_len - length, 0, length);
+    missing -= length;
+  }
+}
+
+void File::writeAt(const struct iovec* buffers, const int count, const off_t position) const {
+  transferAt(fd_, buffers, count, position, true /* write */, filename_);
+}
+
+void File::prepareReadPage(IoRing& ring, const PageId page_number, Page& page,
+                           const std::uint64_t tag) const {
+  ring.prepareRead(fd_, &page, Page::SIZE, pagePosition(page_number), tag);
+}
+
+void File::prepareReadRun(IoRing& ring, const PageId first_page_number,
+                          const struct iovec* buffers, const int count,
+                          const std::uint64_t tag) const {
+  ring.prepareReadv(fd_, buffers, count, pagePosition(first_page_number), tag);
+}
+
+void File::completeReadPage(const PageId page_number, Page& page,
+                            const int result) const {
+  const std::size_t done = result < 0 ? 0 : (std::size_t) result;
+  if (done < Page::SIZE) {
+    readAt(reinterpret_cast<char*>(&page) + done, Page::SIZE - done,
+           pagePosition(page_number) + (off_t) done);
+  }
 }
 
 
@@ -163,147 +325,142 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
 }
 
 Page PageFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
   Page new_page;
-  Page existing_page;
+  allocatePage(new_page_number, new_page);
+  return new_page;
+}
+
+void PageFile::allocatePage(PageId &new_page_number, Page& new_page) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  FileHeader header = readHeader();
+  new_page.initialize();
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
-		new_page_number = new_page.page_number();
-    header.first_free_page = new_page.next_page_number();
+    // Reuse the page at the head of the free list.
+    new_page_number = header.first_free_page;
+    header.first_free_page = readPageHeader(new_page_number).next_page_number;
     --header.num_free_pages;
 
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
-    } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
-    }
-
     assert((header.num_free_pages == 0) ==
            (header.first_free_page == Page::INVALID_NUMBER));
   }
 	else
 	{
-    new_page.set_page_number(header.num_pages);
-		new_page_number = new_page.page_number();
-
-    if (header.first_used_page == Page::INVALID_NUMBER)
-		{
-      header.first_used_page = new_page.page_number();
-    }
-		else
-		{
-      // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
-    }
+		new_page_number = header.num_pages;
     ++header.num_pages;
   }
-  writePage(new_page_number, new_page.header_, new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
-    // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page.header_, existing_page);
+  new_page.set_page_number(new_page_number);
+
+  // Append the new page to the tail of the used list.
+  new_page.set_prev_page_number(header.last_used_page);
+  if (header.last_used_page == Page::INVALID_NUMBER)
+	{
+    header.first_used_page = new_page_number;
   }
-  writeHeader(header);
+	else
+	{
+    PageHeader tail = readPageHeader(header.last_used_page);
+    tail.next_page_number = new_page_number;
+    writePageHeader(header.last_used_page, tail);
+  }
+  header.last_used_page = new_page_number;
 
-  return new_page;
+  writePage(new_page_number, new_page.header_, new_page);
+  writeHeader(header);
 }
 
 Page PageFile::readPage(const PageId page_number) const {
+  Page page;
+  readPage(page_number, page);
+  return page;
+}
+
+void PageFile::readPage(const PageId page_number, Page& page) const {
   FileHeader header = readHeader();
 
 	if (page_number >= header.num_pages)
 	{
 		throw InvalidPageException(page_number, filename_);
 	}
-	return readPage(page_number, false /* allow_free */);
+  readAt(&page, Page::SIZE, pagePosition(page_number));
+  if (!page.isUsed()) {
+    throw InvalidPageException(page_number, filename_);
+  }
 }
 
-Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
-  Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
-  if (!allow_free && !page.isUsed()) {
+void PageFile::completeReadPage(const PageId page_number, Page& page,
+                                const int result) const {
+  if (page_number >= readHeader().num_pages) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  File::completeReadPage(page_number, page, result);
+  if (!page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
-
-  return page;
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
+	std::lock_guard<std::recursive_mutex> guard(*latch_);
 	PageHeader header = readPageHeader(new_page_number);
 	if (header.current_page_number == Page::INVALID_NUMBER)
 	{
 		// Page has been deleted since it was read.
 		throw InvalidPageException(new_page_number, filename_);
 	}
-	// Page on disk may have had its next page pointer updated since it was read;
-	// we don't modify that, but we do keep all the other modifications to the
+	// Page on disk may have had its list pointers updated since it was read;
+	// we don't modify those, but we do keep all the other modifications to the
 	// page header.
 	const PageId next_page_number = header.next_page_number;
+	const PageId prev_page_number = header.prev_page_number;
 	header = new_page.header_;
 	header.next_page_number = next_page_number;
+	header.prev_page_number = prev_page_number;
 	writePage(new_page_number, header, new_page);
 }
 
 void PageFile::deletePage(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
   FileHeader header = readHeader();
+  if (page_number >= header.num_pages) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  const PageHeader existing = readPageHeader(page_number);
+  if (existing.current_page_number == Page::INVALID_NUMBER) {
+    throw InvalidPageException(page_number, filename_);
+  }
 
-  Page existing_page = readPage(page_number);
-  Page previous_page;
-  // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
-    header.first_used_page = existing_page.next_page_number();
+  // Unlink the page from its neighbours in the used list.
+  if (existing.prev_page_number == Page::INVALID_NUMBER) {
+    header.first_used_page = existing.next_page_number;
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    PageHeader previous = readPageHeader(existing.prev_page_number);
+    previous.next_page_number = existing.next_page_number;
+    writePageHeader(existing.prev_page_number, previous);
+  }
+  if (existing.next_page_number == Page::INVALID_NUMBER) {
+    header.last_used_page = existing.prev_page_number;
+  } else {
+    PageHeader next = readPageHeader(existing.next_page_number);
+    next.prev_page_number = existing.prev_page_number;
+    writePageHeader(existing.next_page_number, next);
   }
+
   // Clear the page and add it to the head of the free list.
-  existing_page.initialize();
-  existing_page.set_next_page_number(header.first_free_page);
+  Page free_page;
+  free_page.set_next_page_number(header.first_free_page);
   header.first_free_page = page_number;
   ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page.header_, previous_page);
-  }
-  writePage(page_number, existing_page.header_, existing_page);
+  writePage(page_number, free_page.header_, free_page);
   writeHeader(header);
 }
 
+void PageFile::pageLinks(const PageId page_number, PageId& prev_page_number,
+                         PageId& next_page_number) const {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  const PageHeader header = readPageHeader(page_number);
+  prev_page_number = header.prev_page_number;
+  next_page_number = header.next_page_number;
+}
+
 FileIterator PageFile::begin() {
   const FileHeader& header = readHeader();
   return FileIterator(this, header.first_used_page);
@@ -315,20 +472,23 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  struct iovec buffers[2] = {
+    {const_cast<PageHeader*>(&header), sizeof(PageHeader)},
+    {const_cast<char*>(&new_page.data_[0]), Page::DATA_SIZE}
+  };
+  writeAt(buffers, 2, pagePosition(page_number));
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  readAt(&header, sizeof(PageHeader), pagePosition(page_number));
   return header;
 }
 
+void PageFile::writePageHeader(const PageId page_number, const PageHeader& header) {
+  writeAt(&header, sizeof(PageHeader), pagePosition(page_number));
+}
+
 
 
 
@@ -362,34 +522,41 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
 }
 
 Page BlobFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
 	Page new_page;
+	allocatePage(new_page_number, new_page);
+	return new_page;
+}
+
+void BlobFile::allocatePage(PageId &new_page_number, Page& new_page) {
+  std::lock_guard<std::recursive_mutex> guard(*latch_);
+  FileHeader header = readHeader();
+	new_page.initialize();
 
 	new_page_number = header.num_pages;
 
 	if (header.first_used_page == Page::INVALID_NUMBER) {
 		header.first_used_page = header.num_pages;
 	}
+	header.last_used_page = new_page_number;
 
 	++header.num_pages;
 
 	writePage(new_page_number, new_page);
 	writeHeader(header);
-
-	return new_page;
 }
 
 Page BlobFile::readPage(const PageId page_number) const {
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	readPage(page_number, page);
 	return page;
 }
 
+void BlobFile::readPage(const PageId page_number, Page& page) const {
+	readAt(&page, Page::SIZE, pagePosition(page_number));
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	writeAt(&new_page, Page::SIZE, pagePosition(new_page_number));
 }
 
 //delePage should not be called for a blob_file, not supported
@@ -7,21 +7,37 @@
 
 #pragma once
 
-#include <fstream>
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 #include "page.h"
 
 namespace badgerdb {
 
 class FileIterator;
+class IoRing;
 
 /**
  * @brief Header metadata for files on disk which contain pages.
  */
 struct FileHeader {
+  /**
+   * Identifies the file as a BadgerDB file.
+   */
+  std::uint32_t magic;
+
+  /**
+   * Version of the layout of the file and page headers the file was written
+   * with.  Files of another version are not opened.
+   */
+  std::uint32_t version;
+
   /**
    * Number of pages allocated in the file.
    */
@@ -42,6 +58,11 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * Page number of the last used page in the file.
+   */
+  PageId last_used_page;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -49,10 +70,13 @@ struct FileHeader {
    * @return  True if the other header is equal to this one.
    */
   bool operator==(const FileHeader& rhs) const {
-    return num_pages == rhs.num_pages &&
+    return magic == rhs.magic &&
+        version == rhs.version &&
+        num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        last_used_page == rhs.last_used_page;
   }
 };
 
@@ -60,15 +84,21 @@ struct FileHeader {
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
+ * The File class wraps a descriptor of an underlying file on disk.  Files contain
  * fixed-sized pages, and they never deallocate space (though they do reuse
  * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * underlying file, they will share the descriptor.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the open_descriptors_ map) and just returns a file object with
+ * the already opened descriptor for the file without actually opening the UNIX file again. 
  *
- * @warning This class is not threadsafe.
+ * Pages are read and written with positional I/O (pread/pwrite), so threads
+ * may read and write pages of the same file at the same time.  Operations
+ * which read and then update the file header or the page list hold a latch
+ * shared by all File objects of the file.  The file header is kept in memory,
+ * shared by all File objects of the file, and written through to disk when
+ * it changes, so reading it costs no I/O.  Writes are not forced to disk
+ * until sync() is called.  Opening and closing files is not threadsafe.
  */
 
 
@@ -124,6 +154,14 @@ class File {
    */
   virtual Page allocatePage(PageId &new_page_number) = 0;
 
+  /**
+   * Allocates a new page in the file, building it in the given page.
+   *
+   * @param new_page_number   Number of the new page returned via this variable.
+   * @param new_page          Page to build the new page in.
+   */
+  virtual void allocatePage(PageId &new_page_number, Page& new_page) = 0;
+
   /**
    * Reads an existing page from the file.
    *
@@ -134,6 +172,83 @@ class File {
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads an existing page from the file straight into the given page, such
+   * as a buffer pool frame, without building a temporary page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Where to put the page.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  virtual void readPage(const PageId page_number, Page& page) const = 0;
+
+  /**
+   * Prepares an asynchronous read of an existing page straight into the given
+   * page on the ring.  Once the completion with the given tag is collected,
+   * completeReadPage() must be called with its result.
+   *
+   * @param ring          Ring to prepare the read on.
+   * @param page_number   Number of page to read.
+   * @param page          Where to put the page; must stay valid until the
+   *                      read completes.
+   * @param tag           Tag of the completion.
+   */
+  void prepareReadPage(IoRing& ring, const PageId page_number, Page& page,
+                       const std::uint64_t tag) const;
+
+  /**
+   * Prepares one asynchronous read of a run of consecutive existing pages
+   * straight into the given buffers, one page each, on the ring.  Once the
+   * completion with the given tag is collected, completeReadPage() must be
+   * called for each page of the run with its share of the result, as
+   * returned by runPageResult().
+   *
+   * @param ring                Ring to prepare the read on.
+   * @param first_page_number   Number of the first page of the run.
+   * @param buffers             One buffer of Page::SIZE bytes per page; the
+   *                            buffers and the array must stay valid until
+   *                            the read completes.
+   * @param count               Number of pages in the run.
+   * @param tag                 Tag of the completion.
+   */
+  void prepareReadRun(IoRing& ring, const PageId first_page_number,
+                      const struct iovec* buffers, const int count,
+                      const std::uint64_t tag) const;
+
+  /**
+   * Returns the part of the result of a run read which fell on one of its
+   * pages, as completeReadPage() takes it.
+   *
+   * @param result  Result of the completion of the run read.
+   * @param index   Index of the page in the run.
+   */
+  static int runPageResult(const int result, const std::size_t index) {
+    if (result < 0) {
+      return result;
+    }
+    const std::size_t before = index * Page::SIZE;
+    if ((std::size_t) result <= before) {
+      return 0;
+    }
+    const std::size_t done = (std::size_t) result - before;
+    return (int) (done < Page::SIZE ? done : Page::SIZE);
+  }
+
+  /**
+   * Finishes a read prepared with prepareReadPage().  A read which failed or
+   * transferred only part of the page is redone synchronously.
+   *
+   * @param page_number   Number of page read.
+   * @param page          Page read into.
+   * @param result        Result of the completion of the read.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   * @throws  FileIOException       If the page cannot be read.
+   */
+  virtual void completeReadPage(const PageId page_number, Page& page,
+                                const int result) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -150,6 +265,28 @@ class File {
    */
   virtual void deletePage(const PageId page_number) = 0;
 
+  /**
+   * Returns the numbers of the used pages before and after the given page in
+   * the file's list of used pages.  Files which keep no such list return
+   * Page::INVALID_NUMBER for both.
+   *
+   * @param page_number       Number of page.
+   * @param prev_page_number  Number of the previous used page returned via
+   *                          this variable.
+   * @param next_page_number  Number of the next used page returned via this
+   *                          variable.
+   */
+  virtual void pageLinks(const PageId page_number, PageId& prev_page_number,
+                         PageId& next_page_number) const;
+
+  /**
+   * Forces the pages written so far to disk.  Writing a page does not do
+   * this by itself, so that a batch of writes costs one sync.
+   *
+   * @throws  FileIOException  If the file cannot be synced.
+   */
+  virtual void sync() const;
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -164,6 +301,14 @@ class File {
    */
 	PageId getFirstPageNo();
 
+  /**
+   * Returns the number of pages allocated in the file, deleted ones
+   * included; page numbers run from 1 to this number.
+   *
+   * @return  Number of pages allocated.
+   */
+  PageId pageCount() const;
+
  protected:
   /**
    * Returns the position of the page with the given number in the file (as an
@@ -172,14 +317,51 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  static off_t pagePosition(const PageId page_number) {
+    return sizeof(FileHeader) + ((off_t) (page_number - 1) * Page::SIZE);
+  }
+
+  /**
+   * Reads into the given buffers from the given position of the file.  Bytes
+   * beyond the end of the file read as zeros.
+   *
+   * @param buffers   Buffers to fill, in order.
+   * @param count     Number of buffers.
+   * @param position  Offset in the file to read from.
+   * @throws  FileIOException  If the read fails.
+   */
+  virtual void readAt(const struct iovec* buffers, const int count, const off_t position) const;
+
+  /**
+   * Reads length bytes at the given position of the file into buffer.
+   */
+  void readAt(void* buffer, const std::size_t length, const off_t position) const {
+    struct iovec vec = {buffer, length};
+    readAt(&vec, 1, position);
+  }
+
+  /**
+   * Writes the given buffers to the given position of the file.
+   *
+   * @param buffers   Buffers to write, in order.
+   * @param count     Number of buffers.
+   * @param position  Offset in the file to write at.
+   * @throws  FileIOException  If the write fails.
+   */
+  virtual void writeAt(const struct iovec* buffers, const int count, const off_t position) const;
+
+  /**
+   * Writes length bytes from buffer to the given position of the file.
+   */
+  void writeAt(const void* buffer, const std::size_t length, const off_t position) const {
+    struct iovec vec = {const_cast<void*>(buffer), length};
+    writeAt(&vec, 1, position);
   }
 
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
    *
    * @param create_new  Whether to create a new file.
    * @throws  FileExistsException     If the underlying file exists and
@@ -190,48 +372,92 @@ class File {
   void openIfNeeded(const bool create_new);
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Closes the underlying file descriptor in <fd_>.
    * This method only closes the file if no other File objects exist that access
    * the same file.
    */
   void close();
 
   /**
-   * Reads the header for this file from disk.
+   * Returns the header for this file, from the copy kept in memory.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Makes the given header the header for this file, in memory and on disk.
+   * Callers hold latch_.
    *
    * @param header  File header to write.
    */
   void writeHeader(const FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
+  /**
+   * Sets the in-memory copy of the file header, without writing it to disk.
+   *
+   * @param header  File header.
+   */
+  void storeHeader(const FileHeader& header);
+
+  /**
+   * @brief In-memory copy of the header of an opened file.
+   *
+   * Fields are atomic so readHeader() takes no latch; a header read while
+   * another thread updates it may mix old and new fields.
+   */
+  struct CachedHeader {
+    std::atomic<PageId> num_pages;
+    std::atomic<PageId> first_used_page;
+    std::atomic<PageId> num_free_pages;
+    std::atomic<PageId> first_free_page;
+    std::atomic<PageId> last_used_page;
+  };
+
+  typedef std::map<std::string, int> DescriptorMap;
   typedef std::map<std::string, int> CountMap;
+  typedef std::map<std::string, std::shared_ptr<std::recursive_mutex> > LatchMap;
+  typedef std::map<std::string, std::shared_ptr<CachedHeader> > HeaderMap;
 
   /**
-   * Streams for opened files.
+   * Descriptors of opened files.
    */
-  static StreamMap open_streams_;
+  static DescriptorMap open_descriptors_;
 
   /**
    * Counts for opened files.
    */
   static CountMap open_counts_;
 
+  /**
+   * Latches serializing updates of the header and page list of opened files.
+   */
+  static LatchMap open_latches_;
+
+  /**
+   * Headers of opened files.
+   */
+  static HeaderMap open_headers_;
+
   /**
    * Name of the file this object represents.
    */
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Descriptor of underlying filesystem object, -1 if not open.
+   */
+  int fd_;
+
+  /**
+   * Latch held while reading and updating the file header or the page list.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<std::recursive_mutex> latch_;
+
+  /**
+   * Header of the file, shared by all File objects of the file.
+   */
+  std::shared_ptr<CachedHeader> cached_header_;
 
   friend class FileIterator;
 };
@@ -249,10 +475,10 @@ class PageFile : public File {
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_descriptors_ map.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
@@ -294,12 +520,22 @@ class PageFile : public File {
   ~PageFile();
 
   /**
-   * Allocates a new page in the file.
+   * Allocates a new page in the file, reusing a deleted page if there is one.
+   * The new page is appended to the used list, so the pages of a file are
+   * visited in the order they were allocated.  Takes constant time.
    *
    * @return The new page.
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file, building it in the given page.
+   *
+   * @param new_page_number   Number of the new page returned via this variable.
+   * @param new_page          Page to build the new page in.
+   */
+  void allocatePage(PageId &new_page_number, Page& new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -310,6 +546,25 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file straight into the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Where to put the page.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page& page) const;
+
+  /**
+   * Finishes a read prepared with prepareReadPage(), checking that the page
+   * is in use.
+   *
+   * @see File::completeReadPage()
+   */
+  void completeReadPage(const PageId page_number, Page& page,
+                        const int result) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -320,12 +575,24 @@ class PageFile : public File {
   void writePage(const PageId page_number, const Page& new_page);
 
   /**
-   * Deletes a page from the file.
+   * Deletes a page from the file.  Takes constant time, as the used list is
+   * linked both ways.
    *
    * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Returns the links of the given page in the used list, as they are on
+   * disk.
+   *
+   * @see File::pageLinks()
+   */
+  void pageLinks(const PageId page_number, PageId& prev_page_number,
+                 PageId& next_page_number) const;
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -343,21 +610,6 @@ class PageFile : public File {
 
  private:
 
-  /**
-   * Reads a page from the file.  If <allow_free> is not set, an exception
-   * will be thrown if the page read from disk is not currently in use.
-   *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
-   *
-   * @param page_number   Number of page to read.
-   * @param allow_free    Whether to allow reading a free (unused) page.
-   * @return  The page.
-   * @throws  InvalidPageException  If the page is free (unused) and
-   *                                allow_free is false.
-   */
-  Page readPage(const PageId page_number, const bool allow_free) const;
-
   /**
    * Writes a page into the file at the given page number with the given header.
    * This does not ensure that the number in the header equals the position on
@@ -379,6 +631,15 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Writes only the header of the given page to disk, leaving the record
+   * data and slot table as they are.  No bounds checking is performed.
+   *
+   * @param page_number   Number of page whose header is to be written.
+   * @param header        Header to write.
+   */
+  void writePageHeader(const PageId page_number, const PageHeader& header);
+
   friend class FileIterator;
 };
 
@@ -395,10 +656,10 @@ class BlobFile : public File {
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
+	 * It first checks if the file is already open. If so, then the new File object created uses the same descriptor to read to or write fom
 	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the descriptor associated with this File object are inserted into the
+	 * open_descriptors_ map.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
@@ -448,6 +709,14 @@ class BlobFile : public File {
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file, building it in the given page.
+   *
+   * @param new_page_number   Number of the new page returned via this variable.
+   * @param new_page          Page to build the new page in.
+   */
+  void allocatePage(PageId &new_page_number, Page& new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -458,6 +727,16 @@ class BlobFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file straight into the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Where to put the page.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page& page) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
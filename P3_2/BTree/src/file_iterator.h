@@ -18,7 +18,9 @@ namespace badgerdb {
  * @brief Iterator for iterating over the pages in a file.
  *
  * This class provides a forward-only iterator for iterating over all of the
- * pages in a file.
+ * pages in a file.  Pages are visited in the order they were allocated, not
+ * in page number order: a deleted page reused by a later allocation comes
+ * last, after the pages allocated before it.
  */
 class FileIterator {
  public:
@@ -85,15 +87,22 @@ class FileIterator {
    * @return    True if other iterator is equal to this one.
    */
 	inline bool operator==(const FileIterator& rhs) const {
-    return file_->filename() == rhs.file_->filename() &&
+    return file_ == rhs.file_ &&
         current_page_number_ == rhs.current_page_number_;
   }
 
 	inline bool operator!=(const FileIterator& rhs) const {
-    return (file_->filename() != rhs.file_->filename()) ||
+    return (file_ != rhs.file_) ||
         (current_page_number_ != rhs.current_page_number_);
   }
 
+  /**
+   * Returns the number of the current page, without reading it.
+   *
+   * @return  Page number.
+   */
+  PageId page_number() const { return current_page_number_; }
+
   /**
    * Dereferences the iterator, returning a copy of the current page in the
    * file.
@@ -11,99 +11,82 @@
 namespace badgerdb { 
 
 FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
+  : file(new PageFile(name, false)),	//dont create new file
+    bufMgr(bufferMgr),
+    strategy(RING_SIZE + bufferMgr->readAhead()),
+    prefetchCursor(Page::INVALID_NUMBER),
+    curPage(NULL),
+    filePageIter(bufferMgr, file, Page::INVALID_NUMBER, &strategy),
+    scanStarted(false)
 {
-  file = new PageFile(name, false);	//dont create new file
-	bufMgr = bufferMgr;
-	curDirtyFlag = false;
-  curPage = NULL;
-	filePageIter = file->begin();
 }
 
 FileScan::~FileScan()
 {
   // generally must unpin last page of the scan
-  if (curPage != NULL)
-  {
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-		curDirtyFlag = false;
-    filePageIter = file->begin();
-  }
+  filePageIter.release();
+  curPage = NULL;
   bufMgr->flushFile(file);
   delete file;
 }
 
 void FileScan::scanNext(RecordId& outRid)
 {
-  std::string rec;
-
-  if (filePageIter == file->end())
-	{
-		throw EndOfFileException();
-	}
-
   // special case of the first record of the first page of the file
   if (curPage == NULL)
   {
-    // need to get the first page of the file
-		filePageIter = file->begin();
-    if(filePageIter == file->end())
+    if (scanStarted)
 		{
 			throw EndOfFileException();
 		}
-	 
-		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
-		curDirtyFlag = false;
-
-		// get the first record off the page
-    pageRecordIter = curPage->begin(); 
+    scanStarted = true;
 
-		if(pageRecordIter != curPage->end()) 
+    // read the first page of the file
+    filePageIter.seek(file->getFirstPageNo());
+    if (filePageIter.atEnd())
 		{
-		  // get pointer to record
-		  rec = *pageRecordIter;
-
-			outRid = pageRecordIter.getCurrentRecord();
-			return;
+			throw EndOfFileException();
 		}
-  }
+    curPage = &*filePageIter;
+    readAhead();
 
-	// Loop, looking for a record that satisfied the predicate.
-	// First try and get the next record off the current page
-	pageRecordIter++;
+		// get the first record off the page
+    pageRecordIter = curPage->begin(); 
+  }
+  else
+  {
+    // First try and get the next record off the current page
+    pageRecordIter++;
+  }
 
   while (pageRecordIter == curPage->end())
   {
-    // unpin the current page
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
+    // unpin the current page and read the next page of the file
     curPage = NULL;
-    curDirtyFlag = false;
-
-    filePageIter++;
-    if (filePageIter == file->end())
+    ++filePageIter;
+    if (filePageIter.atEnd())
     {
-      curPage = NULL;
 			throw EndOfFileException();
     }
-
-    // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+    curPage = &*filePageIter;
+    readAhead();
 
     // get the first record off the page
     pageRecordIter = curPage->begin(); 
   }
 
   // curRec points at a valid record
-  // see if the record satisfies the scan's predicate 
-  // get a pointer to the record
-  rec = *pageRecordIter;
-
 	// return rid of the record
 	outRid = pageRecordIter.getCurrentRecord();
 	return;
 }
 
+void FileScan::readAhead()
+{
+  bufMgr->readAheadFrom(file, curPage->page_number(), curPage->next_page_number(), prefetchCursor,
+                        [](const Page& page) { return page.next_page_number(); }, &strategy);
+}
+
 // returns pointer to the current record.  page is left pinned
 // and the scan logic is required to unpin the page 
 std::string FileScan::getRecord()
@@ -114,7 +97,7 @@ std::string FileScan::getRecord()
 // mark current page of scan dirty
 void FileScan::markDirty()
 {
-  curDirtyFlag = true;
+  filePageIter.markDirty();
 }
 
 }
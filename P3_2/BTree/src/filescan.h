@@ -8,11 +8,12 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
 #include "types.h"
 #include "page.h"
 #include "buffer.h"
-#include "file_iterator.h"
+#include "pinned_file_iterator.h"
 #include "page_iterator.h"
 
 namespace badgerdb {
@@ -23,6 +24,10 @@ namespace badgerdb {
 class FileScan
 {
  public:
+  /**
+   * Number of buffer frames a scan cycles through besides those of the pages it reads ahead, see BufferAccessStrategy.
+   */
+  static const std::uint32_t RING_SIZE = 8;
 
   FileScan(const std::string &name, BufMgr *bufMgr);
 
@@ -49,17 +54,35 @@ class FileScan
 	BufMgr				*bufMgr;
 
   /**
-   * Current page being scanned.
+   * Ring of frames the scan reads pages into, so it does not flood the pool.
+   */
+  BufferAccessStrategy strategy;
+
+  /**
+   * Asks the buffer manager to read the pages following the current one in the background.
+   */
+  void readAhead();
+
+  /**
+   * Last page the scan has asked to be read ahead.
+   */
+  std::atomic<PageId> prefetchCursor;
+
+  /**
+   * Current page being scanned, in its buffer pool frame.
    */
   Page*         curPage;
 
-  FileIterator  filePageIter;
+  /**
+   * Keeps the current page pinned and walks the pages of the file through the buffer pool.
+   */
+  PinnedFileIterator  filePageIter;
   PageIterator  pageRecordIter;
 
   /**
-   * True if page has been updated
+   * True once the scan has read its first page
    */
-  bool  	      curDirtyFlag;
+  bool          scanStarted;
 };
 
 }
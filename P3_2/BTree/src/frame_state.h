@@ -0,0 +1,157 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * Size of a CPU cache line; dense per frame arrays start on a line boundary.
+ */
+static const std::size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * Allocates a cache line aligned array of count default constructed objects.
+ *
+ * @param count  Number of elements
+ * @return  The array, to be released with freeAlignedArray().
+ */
+template <class T>
+T* allocAlignedArray(const std::size_t count)
+{
+	void* memory = NULL;
+	if (posix_memalign(&memory, CACHE_LINE_SIZE, (count > 0 ? count : 1) * sizeof(T)) != 0)
+		throw std::bad_alloc();
+
+	T* array = static_cast<T*>(memory);
+	for (std::size_t i = 0; i < count; i++)
+		new (&array[i]) T();
+	return array;
+}
+
+/**
+ * Destroys and releases an array allocated by allocAlignedArray().
+ *
+ * @param array  The array
+ * @param count  Number of elements it was allocated with
+ */
+template <class T>
+void freeAlignedArray(T* array, const std::size_t count)
+{
+	for (std::size_t i = 0; i < count; i++)
+		array[i].~T();
+	free(array);
+}
+
+/**
+ * @brief Dense set of one bit per buffer frame.
+ *
+ * Bits are kept in cache line aligned 64 bit words, so a sweep over the pool
+ * can look at 64 frames with a single load.  All operations are atomic.
+ */
+class FrameBitset
+{
+ public:
+	/**
+	 * Number of frames covered by one word
+	 */
+	static const std::uint32_t BITS_PER_WORD = 64;
+
+	/**
+	 * Constructor of FrameBitset class; all bits start cleared.
+	 *
+	 * @param numBits  Number of frames
+	 */
+	explicit FrameBitset(const std::uint32_t numBits)
+		: numWords((numBits + BITS_PER_WORD - 1) / BITS_PER_WORD)
+	{
+		words = allocAlignedArray<std::atomic<std::uint64_t> >(numWords);
+		for (std::uint32_t i = 0; i < numWords; i++)
+			words[i] = 0;
+	}
+
+	~FrameBitset()
+	{
+		freeAlignedArray(words, numWords);
+	}
+
+	/**
+	 * Returns the bit of the given frame.
+	 */
+	bool test(const FrameId frame) const
+	{
+		return (words[frame / BITS_PER_WORD].load() & mask(frame)) != 0;
+	}
+
+	/**
+	 * Sets the bit of the given frame.
+	 */
+	void set(const FrameId frame)
+	{
+		words[frame / BITS_PER_WORD].fetch_or(mask(frame));
+	}
+
+	/**
+	 * Clears the bit of the given frame.
+	 */
+	void reset(const FrameId frame)
+	{
+		words[frame / BITS_PER_WORD].fetch_and(~mask(frame));
+	}
+
+	/**
+	 * Clears the bit of the given frame and returns its previous value.
+	 */
+	bool testAndReset(const FrameId frame)
+	{
+		return (words[frame / BITS_PER_WORD].fetch_and(~mask(frame)) & mask(frame)) != 0;
+	}
+
+	/**
+	 * Returns the word holding the bits of frames wordNo * BITS_PER_WORD and up, lowest frame in the lowest bit.
+	 */
+	std::uint64_t word(const std::uint32_t wordNo) const
+	{
+		return words[wordNo].load();
+	}
+
+	/**
+	 * Clears the given bits of a word.
+	 */
+	void resetBits(const std::uint32_t wordNo, const std::uint64_t bits)
+	{
+		words[wordNo].fetch_and(~bits);
+	}
+
+ private:
+	FrameBitset(const FrameBitset&);
+	FrameBitset& operator=(const FrameBitset&);
+
+	static std::uint64_t mask(const FrameId frame)
+	{
+		return std::uint64_t(1) << (frame % BITS_PER_WORD);
+	}
+
+	/**
+	 * Number of words
+	 */
+	std::uint32_t numWords;
+
+	/**
+	 * The bits
+	 */
+	std::atomic<std::uint64_t>* words;
+};
+
+}
@@ -0,0 +1,215 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "free_space_map.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "exceptions/invalid_page_exception.h"
+#include "pinned_file_iterator.h"
+
+namespace badgerdb {
+
+FreeSpaceMap::FreeSpaceMap(BufMgr* bufMgr, PageFile* heap)
+  : bufMgr(bufMgr), heap(heap),
+    map(mapName(heap->filename()), !File::exists(mapName(heap->filename()))), searchStart(0)
+{
+  // one read per map page, i.e. per ENTRIES_PER_PAGE heap pages
+  const PageId mapPages = map.pageCount();
+  maxClasses.resize(mapPages, 0);
+  for (PageId mapPageNo = 1; mapPageNo <= mapPages; mapPageNo++)
+  {
+    Page* page;
+    bufMgr->readPage(&map, mapPageNo, page);
+    const std::uint8_t* first = entries(page);
+    maxClasses[mapPageNo - 1] = *std::max_element(first, first + ENTRIES_PER_PAGE);
+    bufMgr->unPinPage(&map, mapPageNo, false);
+  }
+}
+
+FreeSpaceMap::~FreeSpaceMap()
+{
+  try
+  {
+    bufMgr->flushFile(&map);
+  }
+  catch (...)
+  {
+    // a map page still pinned is written when the buffer manager goes away
+  }
+}
+
+PageId FreeSpaceMap::findPage(const std::size_t bytes)
+{
+  const std::size_t needed = (bytes + GRANULARITY - 1) / GRANULARITY;
+  if (needed > MAX_CLASS)
+    return Page::INVALID_NUMBER;
+
+  std::lock_guard<std::mutex> guard(latch);
+  return findLocked((std::uint8_t) needed);
+}
+
+PageId FreeSpaceMap::findLocked(const std::uint8_t needed)
+{
+  for (std::size_t i = 0; i < maxClasses.size(); i++)
+  {
+    const std::size_t index = (searchStart + i) % maxClasses.size();
+    if (maxClasses[index] < needed)
+      continue;
+
+    const PageId mapPageNo = (PageId) index + 1;
+    Page* page;
+    bufMgr->readPage(&map, mapPageNo, page);
+    const std::uint8_t* first = entries(page);
+    const std::uint8_t* last = first + ENTRIES_PER_PAGE;
+    // heap page 0 does not exist
+    const std::uint8_t* found = std::find_if(index == 0 ? first + 1 : first, last,
+                                             [needed](std::uint8_t entry) { return entry >= needed; });
+    if (found == last)
+    {
+      // the largest class went down since it was noted
+      maxClasses[index] = *std::max_element(first, last);
+      bufMgr->unPinPage(&map, mapPageNo, false);
+      continue;
+    }
+
+    const PageId pageNo = (PageId) (index * ENTRIES_PER_PAGE + (found - first));
+    bufMgr->unPinPage(&map, mapPageNo, false);
+    searchStart = index;
+    return pageNo;
+  }
+  return Page::INVALID_NUMBER;
+}
+
+void FreeSpaceMap::setClass(const PageId pageNo, const std::uint8_t pageClass)
+{
+  const PageId mapPageNo = pageNo / ENTRIES_PER_PAGE + 1;
+  if (mapPageNo > maxClasses.size())
+  {
+    // a full page needs no entry
+    if (pageClass == 0)
+      return;
+
+    while (maxClasses.size() < mapPageNo)
+    {
+      PageId newPageNo;
+      Page* page;
+      bufMgr->allocPage(&map, newPageNo, page);
+      std::memset(entries(page), 0, Page::SIZE);
+      bufMgr->unPinPage(&map, newPageNo, true);
+      maxClasses.push_back(0);
+    }
+  }
+
+  Page* page;
+  bufMgr->readPage(&map, mapPageNo, page);
+  std::uint8_t& entry = entries(page)[pageNo % ENTRIES_PER_PAGE];
+  const bool changed = entry != pageClass;
+  entry = pageClass;
+  bufMgr->unPinPage(&map, mapPageNo, changed);
+  maxClasses[mapPageNo - 1] = std::max(maxClasses[mapPageNo - 1], pageClass);
+}
+
+RecordId FreeSpaceMap::insertRecord(const std::string& record)
+{
+  const std::size_t needed = (record.size() + sizeof(PageSlot) + GRANULARITY - 1) / GRANULARITY;
+
+  std::lock_guard<std::mutex> guard(latch);
+  PageId pageNo = Page::INVALID_NUMBER;
+  Page* page;
+  while (needed <= MAX_CLASS && (pageNo = findLocked((std::uint8_t) needed)) != Page::INVALID_NUMBER)
+  {
+    try
+    {
+      bufMgr->readPage(heap, pageNo, page);
+    }
+    catch (InvalidPageException&)
+    {
+      // deleted without the map being told
+      setClass(pageNo, 0);
+      continue;
+    }
+
+    if (page->hasSpaceForRecord(record))
+      break;
+
+    // the entry was out of date
+    setClass(pageNo, classOf(*page));
+    bufMgr->unPinPage(heap, pageNo, false);
+  }
+
+  if (pageNo == Page::INVALID_NUMBER)
+    bufMgr->allocPage(heap, pageNo, page);
+
+  RecordId rid;
+  try
+  {
+    rid = page->insertRecord(record);
+  }
+  catch (...)
+  {
+    // only a new page can lack the room
+    setClass(pageNo, classOf(*page));
+    bufMgr->unPinPage(heap, pageNo, true);
+    throw;
+  }
+  setClass(pageNo, classOf(*page));
+  bufMgr->unPinPage(heap, pageNo, true);
+  return rid;
+}
+
+void FreeSpaceMap::deleteRecord(const RecordId& rid)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  Page* page;
+  bufMgr->readPage(heap, rid.page_number, page);
+  try
+  {
+    page->deleteRecord(rid);
+  }
+  catch (...)
+  {
+    bufMgr->unPinPage(heap, rid.page_number, false);
+    throw;
+  }
+  setClass(rid.page_number, classOf(*page));
+  bufMgr->unPinPage(heap, rid.page_number, true);
+}
+
+void FreeSpaceMap::update(const PageId pageNo, const Page& page)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  setClass(pageNo, classOf(page));
+}
+
+void FreeSpaceMap::pageDeleted(const PageId pageNo)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  setClass(pageNo, 0);
+}
+
+void FreeSpaceMap::rebuild()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  // pages not in the used list, deleted ones included, count as full
+  for (std::size_t i = 0; i < maxClasses.size(); i++)
+  {
+    const PageId mapPageNo = (PageId) i + 1;
+    Page* page;
+    bufMgr->readPage(&map, mapPageNo, page);
+    std::memset(entries(page), 0, Page::SIZE);
+    bufMgr->unPinPage(&map, mapPageNo, true);
+    maxClasses[i] = 0;
+  }
+
+  for (PinnedFileIterator it(bufMgr, heap); !it.atEnd(); ++it)
+    setClass(it.page_number(), classOf(*it));
+  searchStart = 0;
+}
+
+}
@@ -0,0 +1,188 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Persistent map of the free space of the pages of a heap PageFile.
+ *
+ * The map keeps one byte per heap page, its free space class: class c means
+ * the page has at least c * GRANULARITY bytes free.  The bytes are stored in
+ * the pages of a BlobFile next to the heap file (see mapName()), entry n of
+ * map page k describing heap page (k - 1) * ENTRIES_PER_PAGE + n, and are
+ * read and written through the buffer pool like any other page.  The largest
+ * class on each map page is kept in memory, so finding a page with room for a
+ * record reads a single map page.
+ *
+ * The map is a hint.  insertRecord() checks the page it is pointed to and
+ * corrects the entry if it was out of date, so a map which is behind the heap
+ * (e.g. after a crash, or for a heap filled without it) only costs space, never
+ * correctness.  rebuild() recomputes the whole map from the heap.
+ *
+ * All methods are threadsafe; inserts and deletes through one map are
+ * serialized.
+ */
+class FreeSpaceMap
+{
+ public:
+	/**
+	 * Bytes of free space per free space class
+	 */
+	static const std::size_t GRANULARITY = 32;
+
+	/**
+	 * Highest free space class
+	 */
+	static const std::uint8_t MAX_CLASS = 255;
+
+	/**
+	 * Number of heap pages described by one map page
+	 */
+	static const PageId ENTRIES_PER_PAGE = Page::SIZE;
+
+	/**
+	 * Returns the name of the file holding the map of the named heap file.
+	 */
+	static std::string mapName(const std::string& heapName)
+	{
+		return heapName + ".fsm";
+	}
+
+	/**
+	 * Opens the map of a heap file, creating it if it does not exist.  Pages of the heap the map has no entry for
+	 * count as full until they are updated or the map is rebuilt.
+	 *
+	 * @param bufMgr 	Buffer manager to read and write the heap and the map with
+	 * @param heap   	Heap file
+	 */
+	FreeSpaceMap(BufMgr* bufMgr, PageFile* heap);
+
+	/**
+	 * Writes the map out of the buffer pool and closes it.
+	 */
+	~FreeSpaceMap();
+
+	/**
+	 * Returns a page of the heap with at least the given number of bytes free, as far as the map knows.
+	 *
+	 * @param bytes  	Free space needed
+	 * @return  Number of the page, or Page::INVALID_NUMBER if no page is known to have that much room.
+	 */
+	PageId findPage(const std::size_t bytes);
+
+	/**
+	 * Inserts a record into a page of the heap with room for it, or into a new page if there is none.
+	 *
+	 * @param record 	Bytes of the record
+	 * @return  ID of the new record.
+	 * @throws  InsufficientSpaceException  If the record does not fit on an empty page.
+	 */
+	RecordId insertRecord(const std::string& record);
+
+	/**
+	 * Deletes a record of the heap and makes its space available to insertRecord().
+	 *
+	 * @param rid    	ID of the record
+	 */
+	void deleteRecord(const RecordId& rid);
+
+	/**
+	 * Records the free space of a heap page changed by the caller.
+	 *
+	 * @param pageNo 	Number of the page
+	 * @param page   	The page as changed
+	 */
+	void update(const PageId pageNo, const Page& page);
+
+	/**
+	 * Records that a heap page has been deleted.
+	 *
+	 * @param pageNo 	Number of the page
+	 */
+	void pageDeleted(const PageId pageNo);
+
+	/**
+	 * Recomputes every entry by walking the used pages of the heap.
+	 */
+	void rebuild();
+
+ private:
+	/**
+	 * Returns the free space class of a page.
+	 */
+	static std::uint8_t classOf(const Page& page)
+	{
+		const std::size_t free = page.getFreeSpace() / GRANULARITY;
+		return (std::uint8_t) (free < MAX_CLASS ? free : MAX_CLASS);
+	}
+
+	/**
+	 * Returns the entries of a map page.
+	 */
+	static std::uint8_t* entries(Page* page)
+	{
+		return reinterpret_cast<std::uint8_t*>(page);
+	}
+
+	/**
+	 * Returns a heap page with an entry of at least the given class, or Page::INVALID_NUMBER.  Callers hold latch.
+	 */
+	PageId findLocked(const std::uint8_t needed);
+
+	/**
+	 * Sets the entry of a heap page, extending the map as needed.  Callers hold latch.
+	 */
+	void setClass(const PageId pageNo, const std::uint8_t pageClass);
+
+	/**
+	 * Buffer manager the heap and the map are read with
+	 */
+	BufMgr* bufMgr;
+
+	/**
+	 * Heap file described
+	 */
+	PageFile* heap;
+
+	/**
+	 * File holding the map
+	 */
+	BlobFile map;
+
+	/**
+	 * Per map page: at least the largest class of its entries; lowered when a search finds it too high
+	 */
+	std::vector<std::uint8_t> maxClasses;
+
+	/**
+	 * Map page the next search starts at, so that inserts fill a page before moving on
+	 */
+	std::size_t searchStart;
+
+	/**
+	 * Serializes the use of the map
+	 */
+	std::mutex latch;
+
+	FreeSpaceMap(const FreeSpaceMap&);
+	FreeSpaceMap& operator=(const FreeSpaceMap&);
+};
+
+}
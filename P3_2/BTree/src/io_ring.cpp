@@ -0,0 +1,332 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "io_ring.h"
+
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+namespace badgerdb {
+
+namespace {
+
+int ioUringSetup(const std::uint32_t entries, io_uring_params* params)
+{
+  return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+int ioUringEnter(const int fd, const std::uint32_t toSubmit, const std::uint32_t minComplete,
+                 const std::uint32_t flags)
+{
+  return (int) syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+int ioUringRegister(const int fd, const std::uint32_t opcode, void* arg, const std::uint32_t count)
+{
+  return (int) syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+std::uint32_t* ringField(void* ring, const std::uint32_t offset)
+{
+  return reinterpret_cast<std::uint32_t*>(static_cast<char*>(ring) + offset);
+}
+
+}
+
+IoRing::IoRing(const std::uint32_t entries, const bool useKernel)
+  : entries(entries), prepared(0), inFlight(0), ringFd(-1),
+    sqRing(NULL), sqRingSize(0), cqRing(NULL), cqRingSize(0), sqes(NULL), sqesSize(0),
+    sqHead(NULL), sqTail(NULL), sqMask(0), sqArray(NULL),
+    cqHead(NULL), cqTail(NULL), cqMask(0), cqes(NULL), localTail(0)
+{
+  if (!useKernel)
+    return;
+
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ringFd = ioUringSetup(entries, &params);
+  if (ringFd < 0)
+  {
+    ringFd = -1;
+    return;
+  }
+  mapRings(&params);
+  // without the operations, every request would fail and be redone by its caller; do without the kernel instead
+  if (ringFd >= 0 && !probeOps())
+    release();
+}
+
+IoRing::~IoRing()
+{
+  Completion completion;
+  while (inFlight > 0 && wait(completion))
+  {
+  }
+  release();
+}
+
+void IoRing::mapRings(const void* p)
+{
+  const io_uring_params& params = *static_cast<const io_uring_params*>(p);
+  sqRingSize = params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+  cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (singleMap && cqRingSize > sqRingSize)
+    sqRingSize = cqRingSize;
+
+  void* ring = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                    IORING_OFF_SQ_RING);
+  if (ring == MAP_FAILED)
+  {
+    release();
+    return;
+  }
+  sqRing = ring;
+
+  if (singleMap)
+    cqRing = sqRing;
+  else
+  {
+    ring = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                IORING_OFF_CQ_RING);
+    if (ring == MAP_FAILED)
+    {
+      release();
+      return;
+    }
+    cqRing = ring;
+  }
+
+  sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  ring = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+  if (ring == MAP_FAILED)
+  {
+    release();
+    return;
+  }
+  sqes = static_cast<io_uring_sqe*>(ring);
+
+  sqHead = ringField(sqRing, params.sq_off.head);
+  sqTail = ringField(sqRing, params.sq_off.tail);
+  sqMask = *ringField(sqRing, params.sq_off.ring_mask);
+  sqArray = ringField(sqRing, params.sq_off.array);
+  cqHead = ringField(cqRing, params.cq_off.head);
+  cqTail = ringField(cqRing, params.cq_off.tail);
+  cqMask = *ringField(cqRing, params.cq_off.ring_mask);
+  cqes = reinterpret_cast<io_uring_cqe*>(static_cast<char*>(cqRing) + params.cq_off.cqes);
+  localTail = *sqTail;
+
+  // the kernel may round the ring size up, never down
+  if (params.sq_entries < entries)
+    entries = params.sq_entries;
+}
+
+bool IoRing::probeOps() const
+{
+  const std::uint32_t count = IORING_OP_LAST;
+  std::vector<char> buffer(sizeof(io_uring_probe) + count * sizeof(io_uring_probe_op), 0);
+  io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+  // kernels before 5.6 have no probe, nor plain reads and writes
+  if (ioUringRegister(ringFd, IORING_REGISTER_PROBE, probe, count) < 0)
+    return false;
+
+  const std::uint8_t used[] = { IORING_OP_READ, IORING_OP_READV, IORING_OP_WRITE };
+  for (std::size_t i = 0; i < sizeof(used) / sizeof(used[0]); i++)
+  {
+    if (used[i] >= probe->ops_len || (probe->ops[used[i]].flags & IO_URING_OP_SUPPORTED) == 0)
+      return false;
+  }
+  return true;
+}
+
+void IoRing::release()
+{
+  if (sqes != NULL)
+    munmap(sqes, sqesSize);
+  if (cqRing != NULL && cqRing != sqRing)
+    munmap(cqRing, cqRingSize);
+  if (sqRing != NULL)
+    munmap(sqRing, sqRingSize);
+  sqes = NULL;
+  cqRing = sqRing = NULL;
+  if (ringFd >= 0)
+    close(ringFd);
+  ringFd = -1;
+}
+
+io_uring_sqe* IoRing::nextEntry()
+{
+  const std::uint32_t index = localTail & sqMask;
+  io_uring_sqe* sqe = &sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqArray[index] = index;
+  localTail++;
+  return sqe;
+}
+
+void IoRing::prepareRead(const int fd, void* buffer, const std::size_t length, const off_t position,
+                         const std::uint64_t tag)
+{
+  prepared++;
+  if (!async())
+  {
+    Request request = {false, fd, buffer, length, NULL, 0, position, tag};
+    requests.push_back(request);
+    return;
+  }
+  io_uring_sqe* sqe = nextEntry();
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = fd;
+  sqe->addr = (std::uint64_t) (std::uintptr_t) buffer;
+  sqe->len = (std::uint32_t) length;
+  sqe->off = (std::uint64_t) position;
+  sqe->user_data = tag;
+}
+
+void IoRing::prepareReadv(const int fd, const struct iovec* buffers, const int count, const off_t position,
+                          const std::uint64_t tag)
+{
+  prepared++;
+  if (!async())
+  {
+    Request request = {false, fd, NULL, 0, buffers, count, position, tag};
+    requests.push_back(request);
+    return;
+  }
+  io_uring_sqe* sqe = nextEntry();
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = fd;
+  sqe->addr = (std::uint64_t) (std::uintptr_t) buffers;
+  sqe->len = (std::uint32_t) count;
+  sqe->off = (std::uint64_t) position;
+  sqe->user_data = tag;
+}
+
+void IoRing::prepareWrite(const int fd, const void* buffer, const std::size_t length, const off_t position,
+                          const std::uint64_t tag)
+{
+  prepared++;
+  if (!async())
+  {
+    Request request = {true, fd, const_cast<void*>(buffer), length, NULL, 0, position, tag};
+    requests.push_back(request);
+    return;
+  }
+  io_uring_sqe* sqe = nextEntry();
+  sqe->opcode = IORING_OP_WRITE;
+  sqe->fd = fd;
+  sqe->addr = (std::uint64_t) (std::uintptr_t) buffer;
+  sqe->len = (std::uint32_t) length;
+  sqe->off = (std::uint64_t) position;
+  sqe->user_data = tag;
+}
+
+void IoRing::submit()
+{
+  if (prepared == 0)
+    return;
+
+  if (!async())
+  {
+    while (!requests.empty())
+    {
+      const Request& request = requests.front();
+      ssize_t done;
+      do
+      {
+        if (request.write)
+          done = pwrite(request.fd, request.buffer, request.length, request.position);
+        else if (request.buffers != NULL)
+          done = preadv(request.fd, request.buffers, request.count, request.position);
+        else
+          done = pread(request.fd, request.buffer, request.length, request.position);
+      } while (done < 0 && errno == EINTR);
+      Completion completion = {request.tag, done < 0 ? -errno : (int) done};
+      completions.push_back(completion);
+      requests.pop_front();
+    }
+    inFlight += prepared;
+    prepared = 0;
+    return;
+  }
+
+  __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+  while (prepared > 0)
+  {
+    const int submitted = ioUringEnter(ringFd, prepared, 0, 0);
+    if (submitted < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EBUSY)
+      {
+        // make room by collecting completions first
+        if (inFlight > 0)
+          reap(true);
+        else
+          std::this_thread::yield();
+        continue;
+      }
+      // the kernel refused the requests; fail each of them
+      const std::uint32_t head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+      for (std::uint32_t i = head; i != localTail; i++)
+      {
+        Completion completion = {sqes[sqArray[i & sqMask]].user_data, -errno};
+        completions.push_back(completion);
+      }
+      inFlight += prepared;
+      prepared = 0;
+      localTail = head;
+      __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+      return;
+    }
+    prepared -= submitted;
+    inFlight += submitted;
+  }
+}
+
+bool IoRing::wait(Completion& completion)
+{
+  submit();
+  if (inFlight == 0)
+    return false;
+
+  // the kernel may still write into the buffers of requests in flight, so never give up on them
+  while (completions.empty())
+    reap(true);
+  completion = completions.front();
+  completions.pop_front();
+  inFlight--;
+  return true;
+}
+
+void IoRing::reap(const bool block)
+{
+  std::uint32_t head = *cqHead;
+  std::uint32_t tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+  while (block && head == tail)
+  {
+    if (ioUringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+      std::this_thread::yield();
+    tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+  }
+  for (; head != tail; head++)
+  {
+    const io_uring_cqe& cqe = cqes[head & cqMask];
+    Completion completion = {cqe.user_data, cqe.res};
+    completions.push_back(completion);
+  }
+  __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+}
+
+}
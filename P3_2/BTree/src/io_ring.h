@@ -0,0 +1,262 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace badgerdb {
+
+/**
+ * @brief Queue of asynchronous reads and writes, using Linux io_uring.
+ *
+ * Requests are prepared with prepareRead(), prepareReadv() or prepareWrite(), handed to the
+ * kernel together by submit(), and their completions collected, in any order,
+ * with wait().  Each completion carries the tag its request was prepared
+ * with and the result of the transfer: the number of bytes transferred, or a
+ * negative errno value.
+ *
+ * The ring is set up with raw system calls, so no library is needed.  If the
+ * kernel has no io_uring (or it is not allowed), or its io_uring lacks one of
+ * the operations used (plain reads and writes came with Linux 5.6), the ring
+ * works the same way but submit() performs the requests one by one with pread,
+ * preadv and pwrite.  The operations are probed once, when the ring is set up.
+ *
+ * At most capacity() requests may be prepared or in flight at a time.  An
+ * IoRing is used by one thread at a time.
+ */
+class IoRing
+{
+ public:
+	/**
+	 * Result of a request.
+	 */
+	struct Completion {
+		/**
+		 * Tag the request was prepared with
+		 */
+		std::uint64_t tag;
+
+		/**
+		 * Number of bytes transferred, or a negative errno value
+		 */
+		int result;
+	};
+
+	/**
+	 * Sets up a ring.
+	 *
+	 * @param entries   	Most requests in flight at a time
+	 * @param useKernel 	False to do without io_uring even when the kernel has it
+	 */
+	explicit IoRing(const std::uint32_t entries, const bool useKernel = true);
+
+	/**
+	 * Tears the ring down; requests still in flight are waited for first.
+	 */
+	~IoRing();
+
+	/**
+	 * Returns true if requests go through io_uring, false if they are performed synchronously.
+	 */
+	bool async() const
+	{
+		return ringFd >= 0;
+	}
+
+	/**
+	 * Returns the most requests which may be prepared or in flight at a time.
+	 */
+	std::uint32_t capacity() const
+	{
+		return entries;
+	}
+
+	/**
+	 * Returns the number of requests prepared or in flight whose completion has not been collected.
+	 */
+	std::uint32_t outstanding() const
+	{
+		return prepared + inFlight;
+	}
+
+	/**
+	 * Returns true if no more requests may be prepared until a completion is collected.
+	 */
+	bool full() const
+	{
+		return outstanding() >= entries;
+	}
+
+	/**
+	 * Prepares a read of length bytes at the given position of a file into buffer.  The buffer must stay valid
+	 * until the completion is collected.
+	 *
+	 * @param fd     	Descriptor of the file
+	 * @param buffer 	Where to put the bytes
+	 * @param length 	Number of bytes to read
+	 * @param position	Offset in the file
+	 * @param tag    	Tag of the completion
+	 */
+	void prepareRead(const int fd, void* buffer, const std::size_t length, const off_t position,
+	                 const std::uint64_t tag);
+
+	/**
+	 * Prepares a read of the bytes at the given position of a file into several buffers, filled in order, as one
+	 * request.  The buffers and the array describing them must stay valid until the completion is collected.
+	 *
+	 * @param fd     	Descriptor of the file
+	 * @param buffers	Where to put the bytes
+	 * @param count  	Number of buffers
+	 * @param position	Offset in the file
+	 * @param tag    	Tag of the completion
+	 */
+	void prepareReadv(const int fd, const struct iovec* buffers, const int count, const off_t position,
+	                  const std::uint64_t tag);
+
+	/**
+	 * Prepares a write of length bytes from buffer at the given position of a file.  The buffer must stay valid
+	 * until the completion is collected.
+	 *
+	 * @param fd     	Descriptor of the file
+	 * @param buffer 	Bytes to write
+	 * @param length 	Number of bytes to write
+	 * @param position	Offset in the file
+	 * @param tag    	Tag of the completion
+	 */
+	void prepareWrite(const int fd, const void* buffer, const std::size_t length, const off_t position,
+	                  const std::uint64_t tag);
+
+	/**
+	 * Hands the prepared requests to the kernel.  While the kernel has no room for them, completions are collected
+	 * to make room, and kept for wait().
+	 */
+	void submit();
+
+	/**
+	 * Waits for a request to complete, submitting the prepared requests first.  Interrupted or failed waits are
+	 * retried, so this only returns false once every request handed to the kernel has completed and the buffers of
+	 * the requests may be reused.
+	 *
+	 * @param completion	Completion returned via this variable
+	 * @return  False if no request is outstanding.
+	 */
+	bool wait(Completion& completion);
+
+ private:
+	/**
+	 * @brief Request kept until submit() when the kernel has no io_uring
+	 */
+	struct Request {
+		bool write;
+		int fd;
+		void* buffer;
+		std::size_t length;
+		const struct iovec* buffers;
+		int count;
+		off_t position;
+		std::uint64_t tag;
+	};
+
+	/**
+	 * Returns the next submission queue entry, cleared.
+	 */
+	io_uring_sqe* nextEntry();
+
+	/**
+	 * Moves the completions posted by the kernel to completions.
+	 *
+	 * @param block  	True to wait for at least one if there is none
+	 */
+	void reap(const bool block);
+
+	/**
+	 * Maps the rings of the io_uring set up as ringFd; closes it and leaves the ring synchronous on failure.
+	 */
+	void mapRings(const void* params);
+
+	/**
+	 * Returns true if the kernel supports every operation the ring prepares.
+	 */
+	bool probeOps() const;
+
+	/**
+	 * Unmaps the rings and closes ringFd.
+	 */
+	void release();
+
+	/**
+	 * Most requests outstanding at a time
+	 */
+	std::uint32_t entries;
+
+	/**
+	 * Requests prepared and not yet submitted
+	 */
+	std::uint32_t prepared;
+
+	/**
+	 * Requests submitted whose completion has not been collected
+	 */
+	std::uint32_t inFlight;
+
+	/**
+	 * Descriptor of the io_uring, -1 if requests are performed synchronously
+	 */
+	int ringFd;
+
+	/**
+	 * Mapped submission and completion rings and submission queue entries
+	 */
+	void* sqRing;
+	std::size_t sqRingSize;
+	void* cqRing;
+	std::size_t cqRingSize;
+	io_uring_sqe* sqes;
+	std::size_t sqesSize;
+
+	/**
+	 * Fields of the mapped rings
+	 */
+	std::uint32_t* sqHead;
+	std::uint32_t* sqTail;
+	std::uint32_t sqMask;
+	std::uint32_t* sqArray;
+	std::uint32_t* cqHead;
+	std::uint32_t* cqTail;
+	std::uint32_t cqMask;
+	io_uring_cqe* cqes;
+
+	/**
+	 * Next submission queue tail, published by submit()
+	 */
+	std::uint32_t localTail;
+
+	/**
+	 * Requests prepared without io_uring
+	 */
+	std::deque<Request> requests;
+
+	/**
+	 * Completions collected and not yet returned by wait(): those of the requests performed without io_uring, and
+	 * those reaped by submit() to make room in the kernel's queues
+	 */
+	std::deque<Completion> completions;
+
+	// Not copyable; the ring belongs to one object.
+	IoRing(const IoRing&);
+	IoRing& operator=(const IoRing&);
+};
+
+}
@@ -6,11 +6,20 @@
  */
 
 #include <vector>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
 #include "page_iterator.h"
 #include "file_iterator.h"
+#include "pinned_file_iterator.h"
+#include "free_space_map.h"
+#include "mmap_file.h"
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
@@ -19,6 +28,10 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/page_pinned_exception.h"
+#include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/bad_pool_size_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -76,6 +89,7 @@ void intTestsNegative();
 void intTestsSmNum();
 void intTestsSameParam();
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int countPinnedPages(PageFile* file);
 void indexTests();
 void indexTestsOpt(int test_input);
 void test1();
@@ -86,6 +100,22 @@ void test5();
 void test6();
 void test7();
 void test8();
+void test9();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
 void errorTests();
 void deleteRelation();
 
@@ -160,6 +190,22 @@ int main(int argc, char **argv)
     test7();
     test8();
     errorTests();
+    test9();
+    test10();
+    test11();
+    test12();
+    test13();
+    test14();
+    test15();
+    test16();
+    test17();
+    test18();
+    test19();
+    test20();
+    test21();
+    test22();
+    test23();
+    test24();
 
     return 1;
 }
@@ -243,6 +289,913 @@ void test8() {
     deleteRelation();
 }
 
+void test9() {
+    // Allocate and dispose of pages through the buffer pool while walking the file with a pinned iterator
+    std::cout << "----------------------" << std::endl;
+    std::cout << "pinnedIteratorTests" << std::endl;
+    deleteRelation();
+    file1 = new PageFile(relationName, true);
+
+    PageId pageNos[8];
+    Page* page;
+    for (int i = 0; i < 5; i++)
+    {
+        bufMgr->allocPage(file1, pageNos[i], page);
+        bufMgr->unPinPage(file1, pageNos[i], true);
+    }
+    checkPassFail(countPinnedPages(file1), 5)
+
+    bufMgr->disposePage(file1, pageNos[1]);
+    bufMgr->disposePage(file1, pageNos[4]);
+    checkPassFail(countPinnedPages(file1), 3)
+
+    {
+        // pages allocated and disposed of behind and ahead of the iterator
+        PinnedFileIterator it(bufMgr, file1);
+        bufMgr->disposePage(file1, pageNos[2]);
+        for (int i = 5; i < 8; i++)
+        {
+            bufMgr->allocPage(file1, pageNos[i], page);
+            bufMgr->unPinPage(file1, pageNos[i], true);
+        }
+        int visited = 0;
+        for (; !it.atEnd(); ++it)
+            visited++;
+        checkPassFail(visited, 5)
+    }
+
+    bufMgr->flushFile(file1);
+    checkPassFail(countPinnedPages(file1), 5)
+    deleteRelation();
+}
+
+void test10() {
+    // Insert and delete records through a free-space map, then reopen the map and rebuild it
+    std::cout << "----------------------" << std::endl;
+    std::cout << "freeSpaceMapTests" << std::endl;
+    deleteRelation();
+    const std::string mapName = FreeSpaceMap::mapName(relationName);
+    if (File::exists(mapName))
+        File::remove(mapName);
+    file1 = new PageFile(relationName, true);
+
+    memset(record1.s, ' ', sizeof(record1.s));
+    std::vector<RecordId> rids;
+    PageId pagesUsed;
+    {
+        FreeSpaceMap map(bufMgr, file1);
+        for (int i = 0; i < relationSize; i++)
+        {
+            sprintf(record1.s, "%05d string record", i);
+            record1.i = i;
+            record1.d = (double)i;
+            rids.push_back(map.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1))));
+        }
+        pagesUsed = file1->pageCount();
+        for (int i = 0; i < relationSize; i += 2)
+            map.deleteRecord(rids[i]);
+    }
+
+    {
+        // the map kept the freed space
+        FreeSpaceMap map(bufMgr, file1);
+        const bool found = map.findPage(sizeof(record1)) != Page::INVALID_NUMBER;
+        checkPassFail(found, true)
+    }
+
+    bufMgr->flushFile(file1);
+    File::remove(mapName);
+    {
+        // a new map knows nothing until rebuilt from the heap
+        FreeSpaceMap map(bufMgr, file1);
+        bool found = map.findPage(sizeof(record1)) != Page::INVALID_NUMBER;
+        checkPassFail(found, false)
+        map.rebuild();
+        found = map.findPage(sizeof(record1)) != Page::INVALID_NUMBER;
+        checkPassFail(found, true)
+        for (int i = 0; i < relationSize / 2; i++)
+            map.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+        checkPassFail(file1->pageCount(), pagesUsed)
+    }
+
+    bufMgr->flushFile(file1);
+    File::remove(mapName);
+    deleteRelation();
+}
+
+void test11() {
+    // Run the same workload through a pool with each replacement policy
+    std::cout << "----------------------" << std::endl;
+    std::cout << "replacementPolicyTests" << std::endl;
+    const ReplacementPolicyType types[] = { CLOCK, LRU_K, TWO_Q };
+    const std::string names[] = { "clock", "lru-k", "2q" };
+    for (int t = 0; t < 3; t++)
+    {
+        deleteRelation();
+        file1 = new PageFile(relationName, true);
+        BufMgr* pool = new BufMgr(5, types[t]);
+        checkPassFail(std::string(pool->policyName()), names[t])
+
+        const int numPages = 20;
+        PageId pageNos[numPages];
+        Page* page;
+        for (int i = 0; i < numPages; i++)
+        {
+            pool->allocPage(file1, pageNos[i], page);
+            sprintf(record1.s, "%05d policy record", i);
+            page->insertRecord(std::string(record1.s));
+            pool->unPinPage(file1, pageNos[i], true);
+        }
+
+        // LRU-K and 2Q keep a page read between every two pages of a scan in the pool, once it is known to be hot
+        int hotHits = 0;
+        for (int i = 1; i < numPages; i++)
+        {
+            const std::uint64_t hits = pool->getBufStats().hits;
+            pool->readPage(file1, pageNos[0], page);
+            pool->unPinPage(file1, pageNos[0], false);
+            if (i >= numPages / 2 && pool->getBufStats().hits > hits)
+                hotHits++;
+
+            pool->readPage(file1, pageNos[i], page);
+            sprintf(record1.s, "%05d policy record", i);
+            const bool same = *page->begin() == std::string(record1.s);
+            pool->unPinPage(file1, pageNos[i], false);
+            checkPassFail(same, true)
+        }
+        if (types[t] != CLOCK)
+            checkPassFail(hotHits, numPages - numPages / 2)
+
+        pool->flushFile(file1);
+        delete pool;
+    }
+    deleteRelation();
+}
+
+void test12() {
+    // Grow and shrink a buffer pool while pages are pinned in it
+    std::cout << "----------------------" << std::endl;
+    std::cout << "resizeTests" << std::endl;
+    deleteRelation();
+    file1 = new PageFile(relationName, true);
+
+    BufMgr* pool = new BufMgr(10, CLOCK, 20);
+    const int numPages = 10;
+    PageId pageNos[numPages];
+    Page* page;
+    for (int i = 0; i < numPages; i++)
+    {
+        pool->allocPage(file1, pageNos[i], page);
+        sprintf(record1.s, "%05d resized record", i);
+        page->insertRecord(std::string(record1.s));
+    }
+
+    // every frame is pinned, so the pool keeps its size
+    bool pinned = false;
+    try
+    {
+        pool->resize(5);
+    }
+    catch (const PagePinnedException&)
+    {
+        pinned = true;
+    }
+    checkPassFail(pinned, true)
+    checkPassFail(pool->poolSize(), 10)
+
+    for (int i = 0; i < numPages; i++)
+        pool->unPinPage(file1, pageNos[i], true);
+    pool->resize(5);
+    checkPassFail(pool->poolSize(), 5)
+
+    bool tooLarge = false;
+    try
+    {
+        pool->resize(21);
+    }
+    catch (const BadPoolSizeException&)
+    {
+        tooLarge = true;
+    }
+    checkPassFail(tooLarge, true)
+    pool->resize(20);
+    checkPassFail(pool->poolSize(), 20)
+
+    // the pages dropped by the shrink were written back
+    for (int i = 0; i < numPages; i++)
+    {
+        pool->readPage(file1, pageNos[i], page);
+        sprintf(record1.s, "%05d resized record", i);
+        const bool same = *page->begin() == std::string(record1.s);
+        pool->unPinPage(file1, pageNos[i], false);
+        checkPassFail(same, true)
+    }
+
+    pool->flushFile(file1);
+    delete pool;
+    deleteRelation();
+}
+
+void test13() {
+    // Ask for a frame while every frame is pinned, with and without a frame being unpinned in time
+    std::cout << "----------------------" << std::endl;
+    std::cout << "allocWaitTests" << std::endl;
+    deleteRelation();
+    file1 = new PageFile(relationName, true);
+
+    BufMgr* pool = new BufMgr(3);
+    PageId pageNos[4];
+    Page* page;
+    for (int i = 0; i < 3; i++)
+        pool->allocPage(file1, pageNos[i], page);
+
+    bool exceeded = false;
+    try
+    {
+        pool->allocPage(file1, pageNos[3], page);
+    }
+    catch (const BufferExceededException&)
+    {
+        exceeded = true;
+    }
+    checkPassFail(exceeded, true)
+    checkPassFail(pool->getBufStats().allocWaits, 0)
+
+    pool->setAllocWaitTimeout(50);
+    exceeded = false;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    try
+    {
+        pool->allocPage(file1, pageNos[3], page);
+    }
+    catch (const BufferExceededException&)
+    {
+        exceeded = true;
+    }
+    const bool waited = std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(50);
+    checkPassFail(exceeded, true)
+    checkPassFail(waited, true)
+    checkPassFail(pool->getBufStats().allocTimeouts, 1)
+
+    // a frame unpinned during the wait is taken
+    pool->setAllocWaitTimeout(5000);
+    std::thread unpinner([pool, &pageNos] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        pool->unPinPage(file1, pageNos[0], true);
+    });
+    pool->allocPage(file1, pageNos[3], page);
+    unpinner.join();
+    checkPassFail(pool->getBufStats().allocWaits, 2)
+    checkPassFail(pool->getBufStats().allocTimeouts, 1)
+
+    for (int i = 1; i < 4; i++)
+        pool->unPinPage(file1, pageNos[i], true);
+    pool->flushFile(file1);
+    delete pool;
+    deleteRelation();
+}
+
+void test14() {
+    // Log pages in a child process which then dies without writing them, and redo the log
+    std::cout << "----------------------" << std::endl;
+    std::cout << "walRedoTests" << std::endl;
+    deleteRelation();
+    const std::string logName = relationName + ".wal";
+    if (File::exists(logName))
+        File::remove(logName);
+    {
+        PageFile created = PageFile::create(relationName);
+    }
+
+    const int numPages = 3;
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        PageFile file(relationName, false);
+        WriteAheadLog wal(logName);
+        BufMgr* pool = new BufMgr(10);
+        pool->setLog(&wal);
+        for (int i = 0; i < numPages; i++)
+        {
+            PageId pageNo;
+            Page* page;
+            pool->allocPage(&file, pageNo, page);
+            sprintf(record1.s, "%05d logged record", i);
+            page->insertRecord(std::string(record1.s));
+            pool->unPinPage(&file, pageNo, true);
+        }
+        pool->commit();
+        // crash: neither the pool nor the file get to write anything
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    const bool exited = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    checkPassFail(exited, true)
+
+    file1 = new PageFile(relationName, false);
+    int empty = 0;
+    for (FileIterator it = file1->begin(); it != file1->end(); ++it)
+    {
+        Page page = *it;
+        if (page.begin() == page.end())
+            empty++;
+    }
+    checkPassFail(empty, numPages)
+
+    {
+        WriteAheadLog wal(logName);
+        std::vector<File*> files(1, file1);
+        const std::uint32_t applied = wal.redo(files);
+        checkPassFail(applied, (std::uint32_t) numPages)
+    }
+
+    int recovered = 0;
+    for (PinnedFileIterator it(bufMgr, file1); !it.atEnd(); ++it)
+    {
+        sprintf(record1.s, "%05d logged record", recovered);
+        const bool same = it->begin() != it->end() && *it->begin() == std::string(record1.s);
+        checkPassFail(same, true)
+        recovered++;
+    }
+    checkPassFail(recovered, numPages)
+
+    deleteRelation();
+    File::remove(logName);
+}
+
+void test15() {
+    // Pin, dirty and unpin the same pages from several threads through a pool too small to hold them all
+    std::cout << "----------------------" << std::endl;
+    std::cout << "concurrentPinTests" << std::endl;
+    deleteRelation();
+    file1 = new PageFile(relationName, true);
+
+    BufMgr* pool = new BufMgr(5);
+    const int numPages = 8;
+    const int numThreads = 4;
+    const int rounds = 200;
+    PageId pageNos[numPages];
+    Page* page;
+    for (int i = 0; i < numPages; i++)
+    {
+        pool->allocPage(file1, pageNos[i], page);
+        page->insertRecord(std::to_string(0));
+        pool->unPinPage(file1, pageNos[i], true);
+    }
+
+    // each thread bumps a counter on every page once a round; the pool only pins, the test serializes the updates
+    std::vector<std::mutex> latches(numPages);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++)
+    {
+        threads.push_back(std::thread([pool, t, &pageNos, &latches] {
+            for (int r = 0; r < rounds; r++)
+            {
+                for (int i = 0; i < numPages; i++)
+                {
+                    const int p = (i + t) % numPages;
+                    Page* mine;
+                    pool->readPage(file1, pageNos[p], mine);
+                    {
+                        std::lock_guard<std::mutex> guard(latches[p]);
+                        const RecordId rid = mine->begin().getCurrentRecord();
+                        const int count = std::stoi(mine->getRecord(rid));
+                        mine->updateRecord(rid, std::to_string(count + 1));
+                    }
+                    pool->unPinPage(file1, pageNos[p], true);
+                }
+            }
+        }));
+    }
+    for (int t = 0; t < numThreads; t++)
+        threads[t].join();
+
+    // no update was lost to an eviction, and no pin was left behind
+    for (int i = 0; i < numPages; i++)
+    {
+        pool->readPage(file1, pageNos[i], page);
+        const int count = std::stoi(*page->begin());
+        pool->unPinPage(file1, pageNos[i], false);
+        checkPassFail(count, numThreads * rounds)
+
+        bool unpinned = false;
+        try
+        {
+            pool->unPinPage(file1, pageNos[i], false);
+        }
+        catch (const PageNotPinnedException&)
+        {
+            unpinned = true;
+        }
+        checkPassFail(unpinned, true)
+    }
+
+    pool->flushFile(file1);
+    delete pool;
+    deleteRelation();
+}
+
+void test16() {
+    // Close a file and open it again under the same name; its counters go on from where they were
+    std::cout << "----------------------" << std::endl;
+    std::cout << "fileStatsTests" << std::endl;
+    deleteRelation();
+    file1 = new PageFile(relationName, true);
+
+    BufMgr* pool = new BufMgr(10);
+    PageId pageNo;
+    Page* page;
+    pool->allocPage(file1, pageNo, page);
+    pool->unPinPage(file1, pageNo, true);
+    for (int i = 0; i < 3; i++)
+    {
+        pool->readPage(file1, pageNo, page);
+        pool->unPinPage(file1, pageNo, false);
+    }
+    pool->flushFile(file1);
+    delete file1;
+
+    // another object for the same file, quite possibly at the same address
+    file1 = new PageFile(relationName, false);
+    for (int i = 0; i < 2; i++)
+    {
+        pool->readPage(file1, pageNo, page);
+        pool->unPinPage(file1, pageNo, false);
+    }
+    const FileStats stats = pool->statsSnapshot().files[relationName];
+    checkPassFail(stats.hits, (std::uint64_t) 4)
+    checkPassFail(stats.misses, (std::uint64_t) 1)
+    checkPassFail(stats.writes, (std::uint64_t) 1)
+
+    pool->flushFile(file1);
+    delete pool;
+    deleteRelation();
+}
+
+void test17() {
+    // Write pages through memory mapped files, copies and assigned objects, past the mapping and the file end
+    std::cout << "----------------------" << std::endl;
+    std::cout << "mmapFileTests" << std::endl;
+    deleteRelation();
+
+    const int numPages = 10;
+    PageId pageNos[numPages];
+    {
+        // the mapping covers the first few pages only
+        MmapPageFile mapped = MmapPageFile::create(relationName, 4 * Page::SIZE);
+        for (int i = 0; i < numPages; i++)
+        {
+            Page page = mapped.allocatePage(pageNos[i]);
+            sprintf(record1.s, "%05d mapped record", i);
+            page.insertRecord(std::string(record1.s));
+            mapped.writePage(pageNos[i], page);
+        }
+        for (int i = 0; i < numPages; i++)
+        {
+            Page page = mapped.readPage(pageNos[i]);
+            sprintf(record1.s, "%05d mapped record", i);
+            const bool same = *page.begin() == std::string(record1.s);
+            checkPassFail(same, true)
+        }
+
+        // a copy maps the file itself; each sees the writes of the other
+        {
+            MmapPageFile copy(mapped);
+            Page page = copy.readPage(pageNos[1]);
+            page.updateRecord(page.begin().getCurrentRecord(), "copied record");
+            copy.writePage(pageNos[1], page);
+            const bool copied = *mapped.readPage(pageNos[1]).begin() == std::string("copied record");
+            checkPassFail(copied, true)
+
+            PageId grownNo;
+            Page grown = copy.allocatePage(grownNo);
+            grown.insertRecord("grown record");
+            copy.writePage(grownNo, grown);
+            const bool seen = *mapped.readPage(grownNo).begin() == std::string("grown record");
+            checkPassFail(seen, true)
+        }
+
+        // an assigned object drops its old mapping for one of the new file
+        {
+            const std::string otherName = relationName + ".other";
+            if (File::exists(otherName))
+                File::remove(otherName);
+            MmapPageFile assigned = MmapPageFile::create(otherName, 4 * Page::SIZE);
+            assigned = mapped;
+            Page page = assigned.readPage(pageNos[numPages - 1]);
+            page.updateRecord(page.begin().getCurrentRecord(), "assigned record");
+            assigned.writePage(pageNos[numPages - 1], page);
+            File::remove(otherName);
+        }
+        mapped.sync();
+    }
+
+    // a plain file object reads what went through the mappings
+    file1 = new PageFile(relationName, false);
+    const bool copied = *file1->readPage(pageNos[1]).begin() == std::string("copied record");
+    const bool assigned = *file1->readPage(pageNos[numPages - 1]).begin() == std::string("assigned record");
+    checkPassFail(copied, true)
+    checkPassFail(assigned, true)
+    deleteRelation();
+}
+
+void test18() {
+    // Scan a file through a small ring while a few hot pages sit in the pool; the scan must leave them there
+    std::cout << "----------------------" << std::endl;
+    std::cout << "accessStrategyTests" << std::endl;
+    deleteRelation();
+    file1 = new PageFile(relationName, true);
+
+    BufMgr* pool = new BufMgr(10);
+    const int numPages = 40;
+    const int numHot = 5;
+    PageId pageNos[numPages];
+    Page* page;
+    for (int i = 0; i < numPages; i++)
+    {
+        pool->allocPage(file1, pageNos[i], page);
+        pool->unPinPage(file1, pageNos[i], true);
+    }
+    pool->flushFile(file1);
+    for (int i = 0; i < numHot; i++)
+    {
+        pool->readPage(file1, pageNos[i], page);
+        pool->unPinPage(file1, pageNos[i], false);
+    }
+
+    BufferAccessStrategy ring(3);
+    for (int i = numHot; i < numPages; i++)
+    {
+        pool->readPage(file1, pageNos[i], page, &ring);
+        pool->unPinPage(file1, pageNos[i], false);
+    }
+    std::uint64_t hits = pool->getBufStats().hits;
+    for (int i = 0; i < numHot; i++)
+    {
+        pool->readPage(file1, pageNos[i], page);
+        pool->unPinPage(file1, pageNos[i], false);
+    }
+    const std::uint64_t hotHits = pool->getBufStats().hits - hits;
+    checkPassFail(hotHits, (std::uint64_t) numHot)
+
+    // the same scan without the ring pushes them out
+    for (int i = numHot; i < numPages; i++)
+    {
+        pool->readPage(file1, pageNos[i], page);
+        pool->unPinPage(file1, pageNos[i], false);
+    }
+    hits = pool->getBufStats().hits;
+    for (int i = 0; i < numHot; i++)
+    {
+        pool->readPage(file1, pageNos[i], page);
+        pool->unPinPage(file1, pageNos[i], false);
+    }
+    const bool evicted = pool->getBufStats().hits - hits < (std::uint64_t) numHot;
+    checkPassFail(evicted, true)
+
+    pool->flushFile(file1);
+    delete pool;
+    deleteRelation();
+}
+
+void test19() {
+    // Let the background writer clean the dirty pages about to be evicted, so that evicting them writes nothing
+    std::cout << "----------------------" << std::endl;
+    std::cout << "backgroundWriterTests" << std::endl;
+    deleteRelation();
+    file1 = new PageFile(relationName, true);
+
+    // LRU-K lists every unpinned frame as an upcoming victim; the clock only those its hand has passed
+    const int numBufs = 10;
+    BufMgr* pool = new BufMgr(numBufs, LRU_K);
+    PageId pageNos[2 * numBufs];
+    Page* page;
+    for (int i = 0; i < numBufs; i++)
+    {
+        pool->allocPage(file1, pageNos[i], page);
+        sprintf(record1.s, "%05d cleaned record", i);
+        page->insertRecord(std::string(record1.s));
+        pool->unPinPage(file1, pageNos[i], true);
+    }
+
+    pool->startBackgroundWriter(numBufs, 10);
+    for (int wait = 0; wait < 200 && pool->getBufStats().writerWrites < (std::uint64_t) numBufs; wait++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    pool->stopBackgroundWriter();
+    const std::uint64_t cleaned = pool->getBufStats().writerWrites;
+    checkPassFail(cleaned, (std::uint64_t) numBufs)
+
+    // new pages take every frame; the victims are clean
+    for (int i = numBufs; i < 2 * numBufs; i++)
+    {
+        pool->allocPage(file1, pageNos[i], page);
+        pool->unPinPage(file1, pageNos[i], true);
+    }
+    const std::uint64_t dirtyEvictions = pool->getBufStats().dirtyEvictions;
+    checkPassFail(dirtyEvictions, (std::uint64_t) 0)
+
+    // and what the writer wrote is what comes back
+    for (int i = 0; i < numBufs; i++)
+    {
+        pool->readPage(file1, pageNos[i], page);
+        sprintf(record1.s, "%05d cleaned record", i);
+        const bool same = *page->begin() == std::string(record1.s);
+        pool->unPinPage(file1, pageNos[i], false);
+        checkPassFail(same, true)
+    }
+
+    pool->flushFile(file1);
+    delete pool;
+    deleteRelation();
+}
+
+void test20() {
+    // Flush one of two files with dirty pages in the pool; the other keeps its pages, dirty and resident
+    std::cout << "----------------------" << std::endl;
+    std::cout << "flushFileTests" << std::endl;
+    deleteRelation();
+    const std::string otherName = relationName + ".other";
+    if (File::exists(otherName))
+        File::remove(otherName);
+    file1 = new PageFile(relationName, true);
+    PageFile* other = new PageFile(otherName, true);
+
+    BufMgr* pool = new BufMgr(20);
+    const int numPages = 5;
+    PageId pageNos[numPages], otherNos[numPages];
+    Page* page;
+    for (int i = 0; i < numPages; i++)
+    {
+        pool->allocPage(file1, pageNos[i], page);
+        pool->unPinPage(file1, pageNos[i], true);
+        pool->allocPage(other, otherNos[i], page);
+        pool->unPinPage(other, otherNos[i], true);
+    }
+
+    const int writes = pool->getBufStats().diskwrites;
+    pool->flushFile(file1);
+    const int flushed = pool->getBufStats().diskwrites - writes;
+    checkPassFail(flushed, numPages)
+    BufStatsSnapshot stats = pool->statsSnapshot();
+    checkPassFail(stats.files[relationName].writes, (std::uint64_t) numPages)
+    checkPassFail(stats.files[otherName].writes, (std::uint64_t) 0)
+
+    const std::uint64_t hits = pool->getBufStats().hits;
+    for (int i = 0; i < numPages; i++)
+    {
+        pool->readPage(other, otherNos[i], page);
+        pool->unPinPage(other, otherNos[i], false);
+    }
+    const std::uint64_t resident = pool->getBufStats().hits - hits;
+    checkPassFail(resident, (std::uint64_t) numPages)
+
+    pool->flushFile(other);
+    stats = pool->statsSnapshot();
+    checkPassFail(stats.files[otherName].writes, (std::uint64_t) numPages)
+    delete pool;
+    delete other;
+    File::remove(otherName);
+    deleteRelation();
+}
+
+void test21() {
+    // Evict clean pages into the compressed victim cache and read them again; they must come back byte for byte
+    std::cout << "----------------------" << std::endl;
+    std::cout << "victimCacheTests" << std::endl;
+    deleteRelation();
+    file1 = new PageFile(relationName, true);
+
+    BufMgr* pool = new BufMgr(5);
+    pool->setVictimCacheSize(1 << 20);
+    const int numPages = 10;
+    PageId pageNos[numPages];
+    Page* page;
+    for (int i = 0; i < numPages; i++)
+    {
+        pool->allocPage(file1, pageNos[i], page);
+        for (int j = 0; j < 20; j++)
+        {
+            sprintf(record1.s, "%05d victim record %d", i, j * i);
+            page->insertRecord(std::string(record1.s));
+        }
+        pool->unPinPage(file1, pageNos[i], true);
+    }
+    pool->flushFile(file1);
+
+    // the first pages are evicted clean while the rest are read
+    for (int i = 0; i < numPages; i++)
+    {
+        pool->readPage(file1, pageNos[i], page);
+        pool->unPinPage(file1, pageNos[i], false);
+    }
+    const std::uint64_t cacheHits = pool->getBufStats().victimCacheHits;
+    const int reads = pool->getBufStats().diskreads;
+    for (int i = 0; i < numPages / 2; i++)
+    {
+        pool->readPage(file1, pageNos[i], page);
+        const Page onDisk = file1->readPage(pageNos[i]);
+        const bool same = memcmp(page, &onDisk, Page::SIZE) == 0;
+        pool->unPinPage(file1, pageNos[i], false);
+        checkPassFail(same, true)
+    }
+    const std::uint64_t served = pool->getBufStats().victimCacheHits - cacheHits;
+    const int read = pool->getBufStats().diskreads - reads;
+    checkPassFail(served, (std::uint64_t) numPages / 2)
+    checkPassFail(read, 0)
+
+    pool->flushFile(file1);
+    delete pool;
+    deleteRelation();
+}
+
+void test22() {
+    // Dump the resident pages of a pool, reload them into a new pool and read them without a disk read
+    std::cout << "----------------------" << std::endl;
+    std::cout << "warmUpTests" << std::endl;
+    deleteRelation();
+    const std::string dumpName = relationName + ".warm";
+    file1 = new PageFile(relationName, true);
+
+    BufMgr* pool = new BufMgr(20);
+    const int numPages = 30;
+    const int first = 3;
+    const int numResident = 8;
+    PageId pageNos[numPages];
+    Page* page;
+    for (int i = 0; i < numPages; i++)
+    {
+        pool->allocPage(file1, pageNos[i], page);
+        pool->unPinPage(file1, pageNos[i], true);
+    }
+    pool->flushFile(file1);
+    for (int i = first; i < first + numResident; i++)
+    {
+        pool->readPage(file1, pageNos[i], page);
+        pool->unPinPage(file1, pageNos[i], false);
+    }
+    pool->dumpResidentPages(dumpName);
+    pool->flushFile(file1);
+    delete pool;
+
+    pool = new BufMgr(20);
+    const std::uint32_t loaded = pool->warmUp(dumpName, std::vector<File*>(1, file1));
+    checkPassFail(loaded, (std::uint32_t) numResident)
+    const int reads = pool->getBufStats().diskreads;
+    for (int i = first; i < first + numResident; i++)
+    {
+        pool->readPage(file1, pageNos[i], page);
+        pool->unPinPage(file1, pageNos[i], false);
+    }
+    const int read = pool->getBufStats().diskreads - reads;
+    checkPassFail(read, 0)
+
+    // pages which were not resident are not
+    pool->readPage(file1, pageNos[0], page);
+    pool->unPinPage(file1, pageNos[0], false);
+    const int missed = pool->getBufStats().diskreads - reads;
+    checkPassFail(missed, 1)
+
+    pool->flushFile(file1);
+    delete pool;
+    std::remove(dumpName.c_str());
+    deleteRelation();
+}
+
+void test23() {
+    // Read many pages of a file in a class limited to a few frames next to heap pages; the class stays within its quota
+    std::cout << "----------------------" << std::endl;
+    std::cout << "classQuotaTests" << std::endl;
+    deleteRelation();
+    const std::string tempName = relationName + ".temp";
+    if (File::exists(tempName))
+        File::remove(tempName);
+    file1 = new PageFile(relationName, true);
+    PageFile* temp = new PageFile(tempName, true);
+
+    BufMgr* pool = new BufMgr(20);
+    const int numHeap = 10;
+    const int numTemp = 30;
+    const std::uint32_t tempQuota = 5;
+    PageId heapNos[numHeap], tempNos[numTemp];
+    Page* page;
+    for (int i = 0; i < numHeap; i++)
+    {
+        pool->allocPage(file1, heapNos[i], page);
+        pool->unPinPage(file1, heapNos[i], true);
+    }
+    pool->setFileClass(temp, TEMP_CLASS);
+    pool->setClassQuota(TEMP_CLASS, 0, tempQuota);
+
+    std::uint32_t most = 0;
+    for (int i = 0; i < numTemp; i++)
+    {
+        pool->allocPage(temp, tempNos[i], page);
+        pool->unPinPage(temp, tempNos[i], true);
+        most = std::max(most, pool->framesInClass(TEMP_CLASS));
+    }
+    checkPassFail(most, tempQuota)
+    const std::uint32_t heapFrames = pool->framesInClass(HEAP_CLASS);
+    checkPassFail(heapFrames, (std::uint32_t) numHeap)
+
+    pool->flushFile(temp);
+    pool->setFileClass(temp, HEAP_CLASS);
+    delete temp;
+    File::remove(tempName);
+    pool->flushFile(file1);
+    delete pool;
+    deleteRelation();
+}
+
+void test24() {
+    // Checkpoint in a child process, change the pages again, crash, and redo what the checkpoint left of the log
+    std::cout << "----------------------" << std::endl;
+    std::cout << "checkpointRedoTests" << std::endl;
+    deleteRelation();
+    const std::string logName = relationName + ".wal";
+    if (File::exists(logName))
+        File::remove(logName);
+    {
+        PageFile created = PageFile::create(relationName);
+    }
+
+    const int numPages = 3;
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        PageFile file(relationName, false);
+        WriteAheadLog wal(logName);
+        BufMgr* pool = new BufMgr(10);
+        pool->setLog(&wal);
+        PageId pageNos[numPages];
+        Page* page;
+        for (int i = 0; i < numPages; i++)
+        {
+            pool->allocPage(&file, pageNos[i], page);
+            sprintf(record1.s, "%05d first image", i);
+            page->insertRecord(std::string(record1.s));
+            pool->unPinPage(&file, pageNos[i], true);
+        }
+        pool->commit();
+        // writes the first images and drops their records
+        pool->checkpoint();
+
+        for (int i = 0; i < numPages; i++)
+        {
+            pool->readPage(&file, pageNos[i], page);
+            sprintf(record1.s, "%05d last image", i);
+            page->updateRecord(page->begin().getCurrentRecord(), std::string(record1.s));
+            pool->unPinPage(&file, pageNos[i], true);
+        }
+        pool->commit();
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    const bool exited = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    checkPassFail(exited, true)
+
+    file1 = new PageFile(relationName, false);
+    int first = 0;
+    for (FileIterator it = file1->begin(); it != file1->end(); ++it)
+    {
+        Page page = *it;
+        sprintf(record1.s, "%05d first image", first);
+        const bool same = page.begin() != page.end() && *page.begin() == std::string(record1.s);
+        checkPassFail(same, true)
+        first++;
+    }
+    checkPassFail(first, numPages)
+
+    // only the records logged after the checkpoint are left to replay
+    {
+        WriteAheadLog wal(logName);
+        std::vector<File*> files(1, file1);
+        const std::uint32_t applied = wal.redo(files);
+        checkPassFail(applied, (std::uint32_t) numPages)
+    }
+
+    int recovered = 0;
+    for (PinnedFileIterator it(bufMgr, file1); !it.atEnd(); ++it)
+    {
+        sprintf(record1.s, "%05d last image", recovered);
+        const bool same = it->begin() != it->end() && *it->begin() == std::string(record1.s);
+        checkPassFail(same, true)
+        recovered++;
+    }
+    checkPassFail(recovered, numPages)
+
+    deleteRelation();
+    File::remove(logName);
+}
+
+int countPinnedPages(PageFile* file)
+{
+    int count = 0;
+    for (PinnedFileIterator it(bufMgr, file); !it.atEnd(); ++it)
+        count++;
+    return count;
+}
 
 // -----------------------------------------------------------------------------
 // createRelationForward
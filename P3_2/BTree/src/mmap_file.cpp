@@ -0,0 +1,217 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "mmap_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "exceptions/file_io_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+std::size_t totalLength(const struct iovec* buffers, const int count) {
+  std::size_t length = 0;
+  for (int i = 0; i < count; ++i) {
+    length += buffers[i].iov_len;
+  }
+  return length;
+}
+
+}
+
+FileMapping::FileMapping()
+  : base_(NULL), length_(0), size_(0), fd_(-1)
+{
+}
+
+FileMapping::~FileMapping() {
+  unmap();
+}
+
+void FileMapping::map(const int fd, const std::string& filename, const std::size_t length) {
+  unmap();
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    throw FileIOException(filename, "stat", errno);
+  }
+  void* base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    throw FileIOException(filename, "mmap", errno);
+  }
+  base_ = static_cast<char*>(base);
+  length_ = length;
+  size_ = info.st_size;
+  fd_ = fd;
+  filename_ = filename;
+}
+
+void FileMapping::unmap() {
+  if (base_ != NULL) {
+    munmap(base_, length_);
+    base_ = NULL;
+    length_ = 0;
+    size_ = 0;
+    fd_ = -1;
+  }
+}
+
+bool FileMapping::covers(const off_t position, const std::size_t length) const {
+  if (base_ == NULL || (std::size_t) position + length > length_) {
+    return false;
+  }
+  const off_t end = position + (off_t) length;
+  if (end <= size_) {
+    return true;
+  }
+  // The file may have been extended through another File object.
+  struct stat info;
+  if (fstat(fd_, &info) != 0) {
+    return false;
+  }
+  extended(info.st_size);
+  return end <= size_;
+}
+
+bool FileMapping::read(const struct iovec* buffers, const int count, const off_t position) const {
+  if (!covers(position, totalLength(buffers, count))) {
+    return false;
+  }
+  const char* from = base_ + position;
+  for (int i = 0; i < count; ++i) {
+    memcpy(buffers[i].iov_base, from, buffers[i].iov_len);
+    from += buffers[i].iov_len;
+  }
+  return true;
+}
+
+bool FileMapping::write(const struct iovec* buffers, const int count, const off_t position) const {
+  if (!covers(position, totalLength(buffers, count))) {
+    return false;
+  }
+  char* to = base_ + position;
+  for (int i = 0; i < count; ++i) {
+    memcpy(to, buffers[i].iov_base, buffers[i].iov_len);
+    to += buffers[i].iov_len;
+  }
+  return true;
+}
+
+void FileMapping::extended(const off_t size) const {
+  off_t seen = size_;
+  while (seen < size && !size_.compare_exchange_weak(seen, size)) {
+  }
+}
+
+void FileMapping::sync() const {
+  if (base_ == NULL) {
+    return;
+  }
+  const std::size_t used = std::min((std::size_t) size_.load(), length_);
+  if (used != 0 && msync(base_, used, MS_SYNC) != 0) {
+    throw FileIOException(filename_, "msync", errno);
+  }
+}
+
+
+
+
+template <class Base>
+MmapFile<Base>::MmapFile(const std::string& name, const bool create_new,
+                         const std::size_t map_size)
+: Base(name, create_new)
+{
+  mapping_.map(this->fd_, this->filename_, map_size);
+}
+
+template <class Base>
+MmapFile<Base>::MmapFile(const MmapFile& other)
+: Base(other)
+{
+  mapping_.map(this->fd_, this->filename_, other.mapping_.length());
+}
+
+template <class Base>
+MmapFile<Base>& MmapFile<Base>::operator=(const MmapFile& rhs) {
+  const std::size_t map_size = rhs.mapping_.length();
+  mapping_.unmap();
+  Base::operator=(rhs);
+  mapping_.map(this->fd_, this->filename_, map_size);
+  return *this;
+}
+
+template <class Base>
+MmapFile<Base>::~MmapFile() {
+}
+
+template <class Base>
+void MmapFile<Base>::sync() const {
+  mapping_.sync();
+  // Pages past the mapping were written through the descriptor.
+  File::sync();
+}
+
+template <class Base>
+void MmapFile<Base>::readAt(const struct iovec* buffers, const int count,
+                            const off_t position) const {
+  if (!mapping_.read(buffers, count, position)) {
+    File::readAt(buffers, count, position);
+  }
+}
+
+template <class Base>
+void MmapFile<Base>::writeAt(const struct iovec* buffers, const int count,
+                             const off_t position) const {
+  if (!mapping_.write(buffers, count, position)) {
+    File::writeAt(buffers, count, position);
+    mapping_.extended(position + (off_t) totalLength(buffers, count));
+  }
+}
+
+template class MmapFile<PageFile>;
+template class MmapFile<BlobFile>;
+
+
+
+
+MmapPageFile MmapPageFile::create(const std::string& filename, const std::size_t map_size) {
+  return MmapPageFile(filename, true /* create_new */, map_size);
+}
+
+MmapPageFile MmapPageFile::open(const std::string& filename, const std::size_t map_size) {
+  return MmapPageFile(filename, false /* create_new */, map_size);
+}
+
+MmapPageFile::MmapPageFile(const std::string& name, const bool create_new,
+                           const std::size_t map_size)
+: MmapFile<PageFile>(name, create_new, map_size)
+{
+}
+
+
+
+
+MmapBlobFile MmapBlobFile::create(const std::string& filename, const std::size_t map_size) {
+  return MmapBlobFile(filename, true /* create_new */, map_size);
+}
+
+MmapBlobFile MmapBlobFile::open(const std::string& filename, const std::size_t map_size) {
+  return MmapBlobFile(filename, false /* create_new */, map_size);
+}
+
+MmapBlobFile::MmapBlobFile(const std::string& name, const bool create_new,
+                           const std::size_t map_size)
+: MmapFile<BlobFile>(name, create_new, map_size)
+{
+}
+
+}
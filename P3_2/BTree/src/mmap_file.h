@@ -0,0 +1,280 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "file.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Shared read-write memory mapping of the start of a file.
+ *
+ * The mapping reserves a fixed range of addresses when the file is opened,
+ * which may be larger than the file; only the part lying within the file
+ * is ever touched.  When the file grows, the part in use grows with it, so
+ * the mapping never moves and is used without a latch.  Accesses the
+ * mapping does not cover are left to the caller.
+ */
+class FileMapping {
+ public:
+  /**
+   * Constructor of FileMapping class; nothing is mapped.
+   */
+  FileMapping();
+
+  /**
+   * Unmaps the file.
+   */
+  ~FileMapping();
+
+  /**
+   * Maps the first length bytes of a file, replacing any mapping held.
+   *
+   * @param fd        Descriptor of the file, opened for reading and writing.
+   * @param filename  Name of the file, for error messages.
+   * @param length    Number of bytes of addresses to reserve.
+   * @throws  FileIOException  If the file cannot be mapped.
+   */
+  void map(const int fd, const std::string& filename, const std::size_t length);
+
+  /**
+   * Releases the mapping.
+   */
+  void unmap();
+
+  /**
+   * Copies the given range of the file into the buffers.
+   *
+   * @return  False, doing nothing, if the range is not covered by the mapping.
+   */
+  bool read(const struct iovec* buffers, const int count, const off_t position) const;
+
+  /**
+   * Copies the buffers into the given range of the file.
+   *
+   * @return  False, doing nothing, if the range is not covered by the mapping.
+   */
+  bool write(const struct iovec* buffers, const int count, const off_t position) const;
+
+  /**
+   * Records that the file was extended to at least the given size.
+   *
+   * @param size  Size of the file in bytes.
+   */
+  void extended(const off_t size) const;
+
+  /**
+   * Writes the pages changed through the mapping back to the file and waits
+   * for them to reach the disk.
+   *
+   * @throws  FileIOException  If the pages cannot be written.
+   */
+  void sync() const;
+
+  /**
+   * Returns the number of bytes of addresses reserved, 0 if nothing is mapped.
+   */
+  std::size_t length() const { return length_; }
+
+ private:
+  /**
+   * Returns true if the range lies in the part of the mapping backed by the file.
+   */
+  bool covers(const off_t position, const std::size_t length) const;
+
+  /**
+   * First mapped byte, NULL if nothing is mapped.
+   */
+  char* base_;
+
+  /**
+   * Number of bytes of addresses reserved.
+   */
+  std::size_t length_;
+
+  /**
+   * Size of the file as last seen; bytes of the mapping below it may be used.
+   */
+  mutable std::atomic<off_t> size_;
+
+  /**
+   * Descriptor of the file mapped.
+   */
+  int fd_;
+
+  /**
+   * Name of the file mapped.
+   */
+  std::string filename_;
+
+  // Not copyable; each File object maps the file itself.
+  FileMapping(const FileMapping&);
+  FileMapping& operator=(const FileMapping&);
+};
+
+/**
+ * @brief File of type Base which serves page reads and writes from a memory
+ *        mapping of the file.
+ *
+ * Reading a page copies it out of the mapping without a system call, and
+ * writing a page copies it into the mapping; sync() writes changed pages
+ * back with msync().  Pages past the end of the file, such as the page a
+ * call to allocatePage() adds, are written through the file descriptor and
+ * come into the mapping once the file covers them.  Meant for read-mostly
+ * files which fit in memory, such as B+ tree indexes.
+ *
+ * An MmapFile may be used alongside other File objects of the same file.
+ * Instantiated for PageFile and BlobFile, as MmapPageFile and MmapBlobFile.
+ */
+template <class Base>
+class MmapFile : public Base {
+ public:
+  /**
+   * Default number of bytes of the file mapped: 1 GiB.
+   */
+  static const std::size_t DEFAULT_MAP_SIZE = (std::size_t) 1 << 30;
+
+  /**
+   * Unmaps the file and closes it if no other File objects are using it.
+   */
+  ~MmapFile();
+
+  /**
+   * Writes the pages changed through the mapping or the descriptor to disk.
+   *
+   * @throws  FileIOException  If the file cannot be synced.
+   */
+  void sync() const;
+
+ protected:
+  /**
+   * Constructs a file object representing a file on the filesystem.
+   *
+   * @param name        Name of file.
+   * @param create_new  Whether to create a new file.
+   * @param map_size    Number of bytes of the file to map.
+   * @throws  FileExistsException     If the underlying file exists and
+   *                                  create_new is true.
+   * @throws  FileNotFoundException   If the underlying file doesn't exist and
+   *                                  create_new is false.
+   * @throws  FileIOException         If the file cannot be mapped.
+   */
+  MmapFile(const std::string& name, const bool create_new, const std::size_t map_size);
+
+  /**
+   * Copy constructor; the copy maps the file itself.
+   *
+   * @param other File object to copy.
+   */
+  MmapFile(const MmapFile& other);
+
+  /**
+   * Assignment operator.
+   *
+   * @param rhs File object to assign.
+   * @return    Newly assigned file object.
+   */
+  MmapFile& operator=(const MmapFile& rhs);
+
+  using File::readAt;
+  using File::writeAt;
+
+  void readAt(const struct iovec* buffers, const int count, const off_t position) const;
+  void writeAt(const struct iovec* buffers, const int count, const off_t position) const;
+
+ private:
+  /**
+   * Mapping of the file.
+   */
+  FileMapping mapping_;
+};
+
+/**
+ * @brief PageFile which serves page reads and writes from a memory mapping
+ *        of the file.
+ *
+ * @see MmapFile
+ */
+class MmapPageFile : public MmapFile<PageFile> {
+ public:
+  /**
+   * Creates a new file.
+   *
+   * @param filename  Name of the file.
+   * @param map_size  Number of bytes of the file to map.
+   * @throws  FileExistsException     If the requested file already exists.
+   */
+  static MmapPageFile create(const std::string& filename,
+                             const std::size_t map_size = DEFAULT_MAP_SIZE);
+
+  /**
+   * Opens the file named filename and maps it.
+   *
+   * @param filename  Name of the file.
+   * @param map_size  Number of bytes of the file to map.
+   * @throws  FileNotFoundException   If the requested file doesn't exist.
+   */
+  static MmapPageFile open(const std::string& filename,
+                           const std::size_t map_size = DEFAULT_MAP_SIZE);
+
+  /**
+   * Constructs a file object representing a file on the filesystem.
+   *
+   * @see MmapFile::MmapFile
+   */
+  MmapPageFile(const std::string& name, const bool create_new,
+               const std::size_t map_size = DEFAULT_MAP_SIZE);
+};
+
+/**
+ * @brief BlobFile which serves page reads and writes from a memory mapping
+ *        of the file.
+ *
+ * @see MmapFile
+ */
+class MmapBlobFile : public MmapFile<BlobFile> {
+ public:
+  /**
+   * Creates a new MmapBlobFile.
+   *
+   * @param filename  Name of the file.
+   * @param map_size  Number of bytes of the file to map.
+   * @throws  FileExistsException     If the requested file already exists.
+   */
+  static MmapBlobFile create(const std::string& filename,
+                             const std::size_t map_size = DEFAULT_MAP_SIZE);
+
+  /**
+   * Opens the file named filename and maps it.
+   *
+   * @param filename  Name of the file.
+   * @param map_size  Number of bytes of the file to map.
+   * @throws  FileNotFoundException   If the requested file doesn't exist.
+   */
+  static MmapBlobFile open(const std::string& filename,
+                           const std::size_t map_size = DEFAULT_MAP_SIZE);
+
+  /**
+   * Constructs a file object representing a file on the filesystem.
+   *
+   * @see MmapFile::MmapFile
+   */
+  MmapBlobFile(const std::string& name, const bool create_new,
+               const std::size_t map_size = DEFAULT_MAP_SIZE);
+};
+
+extern template class MmapFile<PageFile>;
+extern template class MmapFile<BlobFile>;
+
+}
@@ -29,6 +29,7 @@ void Page::initialize() {
   header_.num_free_slots = 0;
   header_.current_page_number = INVALID_NUMBER;
   header_.next_page_number = INVALID_NUMBER;
+  header_.prev_page_number = INVALID_NUMBER;
   //data_.assign(DATA_SIZE, char());
 	memset(data_, '\0', DATA_SIZE);
 }
@@ -44,11 +45,16 @@ RecordId Page::insertRecord(const std::string& record_data) {
 }
 
 std::string Page::getRecord(const RecordId& record_id) const {
+  std::size_t length;
+  const char* data = getRecordData(record_id, length);
+	return std::string(data, length);
+}
+
+const char* Page::getRecordData(const RecordId& record_id, std::size_t& length) const {
   validateRecordId(record_id);
   const PageSlot& slot = getSlot(record_id.slot_number);
-	std::string retStr = std::string(data_, DATA_SIZE).substr(slot.item_offset, slot.item_length);
-
-	return retStr;
+  length = slot.item_length;
+  return &data_[slot.item_offset];
 }
 
 void Page::updateRecord(const RecordId& record_id,
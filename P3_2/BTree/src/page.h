@@ -21,7 +21,7 @@ namespace badgerdb {
  * @brief Header metadata in a page.
  *
  * Header metadata in each page which tracks where space has been used and
- * contains a pointer to the next page in the file.
+ * contains pointers to the next and previous pages in the file.
  */
 struct PageHeader {
   /**
@@ -58,6 +58,11 @@ struct PageHeader {
    */
   PageId next_page_number;
 
+  /**
+   * Number of the previous used page in the file.
+   */
+  PageId prev_page_number;
+
   /**
    * Returns true if this page header is equal to the other.
    *
@@ -68,7 +73,8 @@ struct PageHeader {
     return num_slots == rhs.num_slots &&
         num_free_slots == rhs.num_free_slots &&
         current_page_number == rhs.current_page_number &&
-        next_page_number == rhs.next_page_number;
+        next_page_number == rhs.next_page_number &&
+        prev_page_number == rhs.prev_page_number;
   }
 };
 
@@ -151,6 +157,17 @@ class Page {
    */
   std::string getRecord(const RecordId& record_id) const;
 
+  /**
+   * Returns where the bytes of the record with the given ID are stored in the
+   * page, without copying them.  The bytes are valid until the page changes.
+   *
+   * @see getRecord
+   * @param record_id  ID of the record to return.
+   * @param length     Length of the record in bytes returned via this variable.
+   * @return  First byte of the record.
+   */
+  const char* getRecordData(const RecordId& record_id, std::size_t& length) const;
+
   /**
    * Updates the record with the given ID, replacing its data with a new
    * version.  This is equivalent to deleting the old record and inserting a
@@ -200,6 +217,13 @@ class Page {
    */
   PageId next_page_number() const { return header_.next_page_number; }
 
+  /**
+   * Returns the number of the used page before this page in its file.
+   *
+   * @return  Page number of previous used page in file.
+   */
+  PageId prev_page_number() const { return header_.prev_page_number; }
+
   /**
    * Returns an iterator at the first record in the page.
    *
@@ -239,6 +263,15 @@ class Page {
     header_.next_page_number = new_next_page_number;
   }
 
+  /**
+   * Sets the number of the used page before this page in its file.
+   *
+   * @param prev_page_number  Page number of previous used page in file.
+   */
+  void set_prev_page_number(const PageId new_prev_page_number) {
+    header_.prev_page_number = new_prev_page_number;
+  }
+
   /**
    * Deletes the record with the given ID.  Page is compacted upon delete to
    * ensure that data of all records is contiguous.  Slot array is compacted if
@@ -337,6 +370,7 @@ class Page {
   friend class PageFile;
   friend class BlobFile;
   friend class PageIterator;
+  friend class BufMgr;
 };
 
 static_assert(Page::SIZE > sizeof(PageHeader),
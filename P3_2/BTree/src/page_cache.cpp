@@ -0,0 +1,192 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "page_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace badgerdb {
+
+// Image format: a sequence of runs, each starting with a control byte c.
+// c < LITERAL_LIMIT: c + 1 bytes follow verbatim.
+// c >= LITERAL_LIMIT: the next byte stands for c - LITERAL_LIMIT + MIN_REPEAT copies of it.
+static const unsigned char LITERAL_LIMIT = 0x80;
+static const std::size_t MAX_LITERAL = LITERAL_LIMIT;
+static const std::size_t MIN_REPEAT = 3;
+static const std::size_t MAX_REPEAT = 0xff - LITERAL_LIMIT + MIN_REPEAT;
+
+bool CompressedPageCache::compress(const Page& page, std::string& image)
+{
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(&page);
+  const std::size_t size = Page::SIZE;
+
+  image.clear();
+  std::size_t literalStart = 0;
+  std::size_t i = 0;
+  while (i < size)
+  {
+    std::size_t run = 1;
+    while (i + run < size && run < MAX_REPEAT && data[i + run] == data[i])
+      run++;
+
+    if (run < MIN_REPEAT && i + run < size)
+    {
+      i += run;
+      continue;
+    }
+
+    // flush the literal bytes before the run (or before the end of the page)
+    const std::size_t literalEnd = run >= MIN_REPEAT ? i : i + run;
+    while (literalStart < literalEnd)
+    {
+      const std::size_t length = std::min(MAX_LITERAL, literalEnd - literalStart);
+      image.push_back((char) (length - 1));
+      image.append(reinterpret_cast<const char*>(data + literalStart), length);
+      literalStart += length;
+    }
+
+    if (run >= MIN_REPEAT)
+    {
+      image.push_back((char) (LITERAL_LIMIT + run - MIN_REPEAT));
+      image.push_back((char) data[i]);
+    }
+    i += run;
+    literalStart = i;
+
+    if (image.size() >= size)
+      return false;
+  }
+  return image.size() < size;
+}
+
+bool CompressedPageCache::decompress(const std::string& image, Page& page)
+{
+  unsigned char* data = reinterpret_cast<unsigned char*>(&page);
+  const std::size_t size = Page::SIZE;
+
+  std::size_t out = 0;
+  std::size_t in = 0;
+  while (in < image.size())
+  {
+    const unsigned char control = (unsigned char) image[in++];
+    if (control < LITERAL_LIMIT)
+    {
+      const std::size_t length = control + 1;
+      if (in + length > image.size() || out + length > size)
+        return false;
+      memcpy(data + out, image.data() + in, length);
+      in += length;
+      out += length;
+    }
+    else
+    {
+      const std::size_t length = control - LITERAL_LIMIT + MIN_REPEAT;
+      if (in >= image.size() || out + length > size)
+        return false;
+      memset(data + out, (unsigned char) image[in++], length);
+      out += length;
+    }
+  }
+  return out == size;
+}
+
+CompressedPageCache::CompressedPageCache()
+  : usedBytes(0), capacityBytes(0)
+{
+}
+
+void CompressedPageCache::setCapacity(const std::size_t bytes)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  capacityBytes = bytes;
+  shrinkTo(bytes);
+}
+
+void CompressedPageCache::insert(const File* file, const PageId pageNo, std::string& image)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  const std::size_t capacity = capacityBytes;
+  if (image.size() > capacity)
+    return;
+
+  const PageKey key(file, pageNo);
+  EntryMap::iterator entry = entries.find(key);
+  if (entry != entries.end())
+    erase(entry);
+
+  shrinkTo(capacity - image.size());
+
+  Entry& added = entries[key];
+  added.image.swap(image);
+  added.position = order.insert(order.end(), key);
+  usedBytes += added.image.size();
+}
+
+bool CompressedPageCache::take(const File* file, const PageId pageNo, Page& page)
+{
+  std::string image;
+  {
+    std::lock_guard<std::mutex> guard(latch);
+    EntryMap::iterator entry = entries.find(PageKey(file, pageNo));
+    if (entry == entries.end())
+      return false;
+
+    image.swap(entry->second.image);
+    usedBytes -= image.size();
+    erase(entry);
+  }
+  return decompress(image, page);
+}
+
+void CompressedPageCache::removeFile(const File* file)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  EntryMap::iterator entry = entries.lower_bound(PageKey(file, 0));
+  while (entry != entries.end() && entry->first.first == file)
+  {
+    EntryMap::iterator next = entry;
+    ++next;
+    erase(entry);
+    entry = next;
+  }
+}
+
+void CompressedPageCache::remove(const File* file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  EntryMap::iterator entry = entries.find(PageKey(file, pageNo));
+  if (entry != entries.end())
+    erase(entry);
+}
+
+std::size_t CompressedPageCache::bytesUsed()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return usedBytes;
+}
+
+std::size_t CompressedPageCache::size()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return entries.size();
+}
+
+void CompressedPageCache::erase(EntryMap::iterator entry)
+{
+  usedBytes -= entry->second.image.size();
+  order.erase(entry->second.position);
+  entries.erase(entry);
+}
+
+void CompressedPageCache::shrinkTo(const std::size_t bytes)
+{
+  while (usedBytes > bytes && !order.empty())
+    erase(entries.find(order.front()));
+}
+
+}
@@ -0,0 +1,181 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Second tier cache holding compressed images of clean pages evicted from the buffer pool.
+ *
+ * BufMgr puts a clean page here when it evicts it and looks here before
+ * reading a page from its file; a page taken back into the pool leaves the
+ * cache, so a page is never both resident and cached.  Images are compressed
+ * with a byte oriented run length code, which is cheap and does well on the
+ * zero filled free space of heap pages and B+ tree nodes.  When the images
+ * exceed the capacity, the least recently inserted ones are dropped.
+ *
+ * PageFile keeps its used pages in a list through the page headers and
+ * changes the links of a page on disk when a page next to it is allocated or
+ * deleted.  BufMgr then drops the image of that page with remove().
+ *
+ * All methods are threadsafe.
+ */
+class CompressedPageCache
+{
+ public:
+	/**
+	 * Compresses a page image.
+	 *
+	 * @param page   	Page to compress
+	 * @param image  	Compressed image returned via this variable
+	 * @return  False if the page does not compress to less than Page::SIZE bytes.
+	 */
+	static bool compress(const Page& page, std::string& image);
+
+	/**
+	 * Restores a page from an image made by compress().
+	 *
+	 * @param image  	Compressed image
+	 * @param page   	Page restored
+	 * @return  False if the image is malformed.
+	 */
+	static bool decompress(const std::string& image, Page& page);
+
+	/**
+	 * Constructor of CompressedPageCache class; the cache starts out disabled.
+	 */
+	CompressedPageCache();
+
+	/**
+	 * Sets the most bytes of compressed images kept, dropping images as needed; 0 disables the cache.
+	 *
+	 * @param bytes  	New capacity in bytes
+	 */
+	void setCapacity(const std::size_t bytes);
+
+	/**
+	 * Returns the most bytes of compressed images kept.
+	 */
+	std::size_t capacity() const
+	{
+		return capacityBytes;
+	}
+
+	/**
+	 * Returns true if the cache takes pages.
+	 */
+	bool enabled() const
+	{
+		return capacityBytes != 0;
+	}
+
+	/**
+	 * Stores the compressed image of a clean page, replacing any image it had.
+	 *
+	 * @param file   	File of the page
+	 * @param pageNo 	Page number in the file
+	 * @param image  	Image from compress(); its contents are taken over
+	 */
+	void insert(const File* file, const PageId pageNo, std::string& image);
+
+	/**
+	 * Removes the page from the cache and restores it.
+	 *
+	 * @param file   	File of the page
+	 * @param pageNo 	Page number in the file
+	 * @param page   	Page restored
+	 * @return  False if the page is not cached.
+	 */
+	bool take(const File* file, const PageId pageNo, Page& page);
+
+	/**
+	 * Drops all images of the file.
+	 *
+	 * @param file   	File object
+	 */
+	void removeFile(const File* file);
+
+	/**
+	 * Drops the image of a page, if there is one.
+	 *
+	 * @param file   	File object
+	 * @param pageNo 	Page number in the file
+	 */
+	void remove(const File* file, const PageId pageNo);
+
+	/**
+	 * Returns the number of bytes of compressed images held.
+	 */
+	std::size_t bytesUsed();
+
+	/**
+	 * Returns the number of pages held.
+	 */
+	std::size_t size();
+
+ private:
+	typedef std::pair<const File*, PageId> PageKey;
+
+	/**
+	 * @brief Compressed image of a page and where it is in the insertion order
+	 */
+	struct Entry {
+		std::string image;
+		std::list<PageKey>::iterator position;
+	};
+
+	typedef std::map<PageKey, Entry> EntryMap;
+
+	/**
+	 * Removes an entry from the images and the insertion order.
+	 */
+	void erase(EntryMap::iterator entry);
+
+	/**
+	 * Drops the oldest entries until at most the given number of bytes are held.
+	 */
+	void shrinkTo(const std::size_t bytes);
+
+	/**
+	 * Protects all members below
+	 */
+	std::mutex latch;
+
+	/**
+	 * Images by page
+	 */
+	EntryMap entries;
+
+	/**
+	 * Pages in order of insertion, oldest first
+	 */
+	std::list<PageKey> order;
+
+	/**
+	 * Bytes of images held
+	 */
+	std::size_t usedBytes;
+
+	/**
+	 * Most bytes of images kept; read without the latch to skip work while the cache is disabled
+	 */
+	std::atomic<std::size_t> capacityBytes;
+};
+
+}
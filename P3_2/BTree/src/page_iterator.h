@@ -82,12 +82,12 @@ class PageIterator {
    * @return    True if other iterator is equal to this one.
    */
 	inline bool operator==(const PageIterator& rhs) const {
-    return page_->page_number() == rhs.page_->page_number() &&
+    return page_ == rhs.page_ &&
         current_record_ == rhs.current_record_;
   }
 
 	inline bool operator!=(const PageIterator& rhs) const {
-    return (page_->page_number() != rhs.page_->page_number()) || 
+    return (page_ != rhs.page_) ||
         (current_record_ != rhs.current_record_);
   }
 
@@ -101,6 +101,17 @@ class PageIterator {
 		return page_->getRecord(current_record_); 
 	}
 
+  /**
+   * Returns where the current record is stored in the page, without copying
+   * it.  The bytes are valid until the page changes.
+   *
+   * @param length  Length of the record in bytes returned via this variable.
+   * @return  First byte of the record.
+   */
+	inline const char* data(std::size_t& length) const {
+		return page_->getRecordData(current_record_, length);
+	}
+
   /**
    * Returns the next used slot in the page after the given slot or
    * Page::INVALID_SLOT if no slots are used after the given slot.
@@ -0,0 +1,205 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cassert>
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Iterator for iterating over the pages in a file through the buffer
+ *        pool.
+ *
+ * Unlike FileIterator, which reads a copy of each page from the file, this
+ * iterator keeps the current page pinned in the buffer pool and gives access
+ * to the frame itself.  Advancing follows the next page number in the frame,
+ * unpins the current page and pins the next one, so a walk over a file hits
+ * pages already in the pool and may use an access strategy.  Pages allocated
+ * or disposed of through BufMgr meanwhile are seen as in the file, as BufMgr
+ * updates the links of resident pages along with those on disk.  Like
+ * FileIterator, it visits the pages in the order they were allocated, so a
+ * reused page number comes after the pages allocated before its reuse.
+ *
+ * The iterator owns the pin of its current page; it cannot be copied.
+ */
+class PinnedFileIterator {
+ public:
+  /**
+   * Constructs an iterator over the pages in a file, starting at the first
+   * page, which is pinned.
+   *
+   * @param bufMgr    Buffer manager to pin pages with.
+   * @param file      File to iterate over.
+   * @param strategy  Access strategy to read pages with, or NULL.
+   */
+  PinnedFileIterator(BufMgr* bufMgr, PageFile* file,
+                     BufferAccessStrategy* strategy = NULL)
+      : bufMgr_(bufMgr),
+        file_(file),
+        strategy_(strategy),
+        page_(NULL),
+        current_page_number_(Page::INVALID_NUMBER),
+        dirty_(false) {
+    assert(bufMgr_ != NULL && file_ != NULL);
+    seek(file_->getFirstPageNo());
+  }
+
+  /**
+   * Constructs an iterator over the pages in a file, starting at the given
+   * page number; Page::INVALID_NUMBER gives the end of the file.
+   *
+   * @param bufMgr      Buffer manager to pin pages with.
+   * @param file        File to iterate over.
+   * @param page_number Number of page to start iterator at.
+   * @param strategy    Access strategy to read pages with, or NULL.
+   */
+  PinnedFileIterator(BufMgr* bufMgr, PageFile* file, PageId page_number,
+                     BufferAccessStrategy* strategy = NULL)
+      : bufMgr_(bufMgr),
+        file_(file),
+        strategy_(strategy),
+        page_(NULL),
+        current_page_number_(Page::INVALID_NUMBER),
+        dirty_(false) {
+    assert(bufMgr_ != NULL && file_ != NULL);
+    seek(page_number);
+  }
+
+  /**
+   * Unpins the current page.
+   */
+  ~PinnedFileIterator() {
+    release();
+  }
+
+  /**
+   * Advances the iterator to the next page in the file.
+   */
+	inline PinnedFileIterator& operator++() {
+    assert(page_ != NULL);
+    seek(page_->next_page_number());
+		return *this;
+	}
+
+  /**
+   * Returns true if this iterator is at the same page of the same File
+   * object as the given iterator.
+   *
+   * @param rhs   Iterator to compare against.
+   * @return    True if other iterator is equal to this one.
+   */
+	inline bool operator==(const PinnedFileIterator& rhs) const {
+    return file_ == rhs.file_ &&
+        current_page_number_ == rhs.current_page_number_;
+  }
+
+	inline bool operator!=(const PinnedFileIterator& rhs) const {
+    return !(*this == rhs);
+  }
+
+  /**
+   * Returns the current page, in its buffer pool frame.
+   *
+   * @return  Page in buffer pool.
+   */
+	inline Page& operator*() const {
+    assert(page_ != NULL);
+    return *page_;
+  }
+
+	inline Page* operator->() const {
+    assert(page_ != NULL);
+    return page_;
+  }
+
+  /**
+   * Returns the number of the current page, Page::INVALID_NUMBER at the end
+   * of the file.
+   *
+   * @return  Page number.
+   */
+  PageId page_number() const { return current_page_number_; }
+
+  /**
+   * Returns true if the iterator has gone past the last page of the file.
+   */
+  bool atEnd() const { return current_page_number_ == Page::INVALID_NUMBER; }
+
+  /**
+   * Marks the current page dirty, so it is written back when unpinned.
+   */
+  void markDirty() { dirty_ = true; }
+
+  /**
+   * Unpins the current page and moves to the given page, pinning it;
+   * Page::INVALID_NUMBER moves to the end of the file.
+   *
+   * @param page_number Number of page to move to.
+   */
+  void seek(const PageId page_number) {
+    release();
+    if (page_number != Page::INVALID_NUMBER) {
+      bufMgr_->readPage(file_, page_number, page_, strategy_);
+      current_page_number_ = page_number;
+    }
+  }
+
+  /**
+   * Unpins the current page and moves to the end of the file.
+   */
+  void release() {
+    if (page_ != NULL) {
+      const PageId page_number = current_page_number_;
+      page_ = NULL;
+      current_page_number_ = Page::INVALID_NUMBER;
+      bufMgr_->unPinPage(file_, page_number, dirty_);
+    }
+    dirty_ = false;
+  }
+
+ private:
+  // Not copyable, as the iterator owns the pin of its current page.
+  PinnedFileIterator(const PinnedFileIterator&);
+  PinnedFileIterator& operator=(const PinnedFileIterator&);
+
+  /**
+   * Buffer manager pages are pinned with.
+   */
+  BufMgr* bufMgr_;
+
+  /**
+   * File we're iterating over.
+   */
+  PageFile* file_;
+
+  /**
+   * Access strategy pages are read with, or NULL.
+   */
+  BufferAccessStrategy* strategy_;
+
+  /**
+   * Current page in its buffer pool frame, NULL at the end of the file.
+   */
+  Page* page_;
+
+  /**
+   * Number of page iterator is currently pointing to.
+   */
+  PageId current_page_number_;
+
+  /**
+   * True if the current page was marked dirty.
+   */
+  bool dirty_;
+};
+
+}
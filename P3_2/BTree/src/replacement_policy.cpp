@@ -0,0 +1,530 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+
+#include "replacement_policy.h"
+
+namespace badgerdb {
+
+ReplacementPolicy* ReplacementPolicy::create(const ReplacementPolicyType type, const std::uint32_t numFrames,
+                                             const std::uint32_t maxFrames)
+{
+  switch (type)
+  {
+    case LRU_K:
+      return new LruKPolicy(numFrames, maxFrames);
+    case TWO_Q:
+      return new TwoQPolicy(numFrames, maxFrames);
+    case CLOCK:
+    default:
+      return new ClockPolicy(numFrames, maxFrames);
+  }
+}
+
+//----------------------------------------
+// Clock
+//----------------------------------------
+
+ClockPolicy::ClockPolicy(const std::uint32_t frames, const std::uint32_t maxFrames)
+  : numFrames(frames), refbits(maxFrames)
+{
+  clockHand = frames - 1;
+}
+
+ClockPolicy::~ClockPolicy()
+{
+}
+
+void ClockPolicy::pageLoaded(const FrameId frame, const File* file, const PageId pageNo)
+{
+  refbits.set(frame);
+}
+
+void ClockPolicy::pageAccessed(const FrameId frame)
+{
+  // set the referenced bit, unless it is set already
+  if (!refbits.test(frame))
+    refbits.set(frame);
+}
+
+void ClockPolicy::pageRemoved(const FrameId frame)
+{
+  refbits.reset(frame);
+}
+
+bool ClockPolicy::pickVictim(FrameId& frame, const FrameFilter& evictable)
+{
+  const std::uint32_t BITS = FrameBitset::BITS_PER_WORD;
+  const std::uint32_t numFrames = this->numFrames;
+
+  // sweep at most twice around: the first round may only clear bits
+  std::uint32_t numScanned = 0;
+  while (numScanned < 2*numFrames)
+  {
+    // look at the frames from the hand to the end of its word at once
+    FrameId hand = clockHand;
+    const FrameId start = (hand + 1) % numFrames;
+    const std::uint32_t wordNo = start / BITS;
+    const std::uint32_t first = start % BITS;
+    const std::uint32_t last = std::min(numFrames - wordNo * BITS, BITS) - 1;
+    const std::uint64_t range = (~std::uint64_t(0) >> (BITS - 1 - last)) & (~std::uint64_t(0) << first);
+    const std::uint64_t referenced = refbits.word(wordNo) & range;
+
+    // the first unreferenced frame which can be evicted is the victim
+    std::uint64_t candidates = ~referenced & range;
+    std::uint32_t stop = last;
+    bool found = false;
+    while (candidates != 0)
+    {
+      const std::uint32_t bit = __builtin_ctzll(candidates);
+      if (evictable(wordNo * BITS + bit))
+      {
+        stop = bit;
+        found = true;
+        break;
+      }
+      candidates &= candidates - 1;
+    }
+
+    // advance the clock past the frames looked at; retry if another thread moved it meanwhile
+    if (!clockHand.compare_exchange_weak(hand, wordNo * BITS + stop))
+      continue;
+
+    // referenced frames passed by the hand lose their bit
+    const std::uint64_t passed = range & (~std::uint64_t(0) >> (BITS - 1 - stop));
+    refbits.resetBits(wordNo, referenced & passed);
+    numScanned += stop - first + 1;
+
+    if (found)
+    {
+      frame = wordNo * BITS + stop;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ClockPolicy::upcomingVictims(const std::uint32_t count, const FrameFilter& evictable,
+                                  std::vector<FrameId>& frames)
+{
+  // frames ahead of the hand whose bit is already clear go next
+  const std::uint32_t numFrames = this->numFrames;
+  const FrameId hand = clockHand;
+  for (std::uint32_t i = 1; i <= numFrames && frames.size() < count; i++)
+  {
+    const FrameId candidate = (hand + i) % numFrames;
+    if (!refbits.test(candidate) && evictable(candidate))
+      frames.push_back(candidate);
+  }
+}
+
+void ClockPolicy::resize(const std::uint32_t frames)
+{
+  // frames leaving the pool must not keep a bit they would find again when it grows
+  for (FrameId i = frames; i < numFrames; i++)
+    refbits.reset(i);
+  numFrames = frames;
+}
+
+//----------------------------------------
+// Pending hits
+//----------------------------------------
+
+PendingHits::PendingHits(const std::uint32_t maxFrames)
+  : clock(0), frames(maxFrames), maxFrames(maxFrames)
+{
+  stamps = allocAlignedArray<std::atomic<std::uint64_t> >(maxFrames);
+  for (FrameId i = 0; i < maxFrames; i++)
+    stamps[i] = 0;
+}
+
+PendingHits::~PendingHits()
+{
+  freeAlignedArray(stamps, maxFrames);
+}
+
+void PendingHits::drain(const std::uint32_t numFrames, std::vector<std::pair<std::uint64_t, FrameId> >& hits)
+{
+  const std::uint32_t BITS = FrameBitset::BITS_PER_WORD;
+  const std::size_t first = hits.size();
+  for (std::uint32_t wordNo = 0; wordNo * BITS < numFrames; wordNo++)
+  {
+    // a hit after the bits are cleared marks its frame again; its stamp is then taken now or by the next call
+    std::uint64_t marked = frames.word(wordNo);
+    if (marked == 0)
+      continue;
+    frames.resetBits(wordNo, marked);
+    while (marked != 0)
+    {
+      const FrameId frame = wordNo * BITS + __builtin_ctzll(marked);
+      marked &= marked - 1;
+      if (frame >= numFrames)
+        break;
+      const std::uint64_t time = take(frame);
+      if (time != 0)
+        hits.push_back(std::make_pair(time, frame));
+    }
+  }
+  std::sort(hits.begin() + first, hits.end());
+}
+
+//----------------------------------------
+// LRU-K
+//----------------------------------------
+
+LruKPolicy::LruKPolicy(const std::uint32_t numFrames, const std::uint32_t maxFrames)
+  : hits(maxFrames), numFrames(numFrames), keys(maxFrames), resident(maxFrames, false), history(maxFrames),
+    maxRetained(numFrames)
+{
+  for (FrameId i = 0; i < numFrames; i++)
+    freeFrames.insert(i);
+}
+
+LruKPolicy::OrderKey LruKPolicy::orderKey(const FrameId frame) const
+{
+  // pages with fewer than K references have times[K-1] == 0 and go first
+  const History& h = history[frame];
+  return std::make_pair(std::make_pair(h.times[K-1], h.times[0]), frame);
+}
+
+void LruKPolicy::retire(const FrameId frame)
+{
+  order.erase(orderKey(frame));
+
+  retainedOrder.push_back(keys[frame]);
+  retained[keys[frame]] = std::make_pair(history[frame], --retainedOrder.end());
+  while (retainedOrder.size() > maxRetained)
+  {
+    retained.erase(retainedOrder.front());
+    retainedOrder.pop_front();
+  }
+}
+
+void LruKPolicy::applyHit(const FrameId frame, const std::uint64_t time)
+{
+  History& h = history[frame];
+  if (time <= h.times[0])
+    return;
+
+  order.erase(orderKey(frame));
+  for (int i = K - 1; i > 0; i--)
+    h.times[i] = h.times[i-1];
+  h.times[0] = time;
+  order.insert(orderKey(frame));
+}
+
+void LruKPolicy::foldHits()
+{
+  std::vector<std::pair<std::uint64_t, FrameId> > pending;
+  hits.drain(numFrames, pending);
+  for (std::size_t i = 0; i < pending.size(); i++)
+  {
+    if (resident[pending[i].second])
+      applyHit(pending[i].second, pending[i].first);
+  }
+}
+
+void LruKPolicy::pageLoaded(const FrameId frame, const File* file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  // the last hits on the page leaving the frame go into the history it retains
+  const std::uint64_t pending = hits.take(frame);
+  if (resident[frame])
+  {
+    if (pending != 0)
+      applyHit(frame, pending);
+    retire(frame);
+  }
+  else
+    freeFrames.erase(frame);
+
+  keys[frame] = PageKey(file, pageNo);
+  History& h = history[frame];
+  RetainedMap::iterator old = retained.find(keys[frame]);
+  if (old != retained.end())
+  {
+    h = old->second.first;
+    retainedOrder.erase(old->second.second);
+    retained.erase(old);
+  }
+  else
+  {
+    for (int i = 0; i < K; i++)
+      h.times[i] = 0;
+  }
+
+  for (int i = K - 1; i > 0; i--)
+    h.times[i] = h.times[i-1];
+  h.times[0] = hits.tick();
+
+  resident[frame] = true;
+  order.insert(orderKey(frame));
+}
+
+void LruKPolicy::pageAccessed(const FrameId frame)
+{
+  // folded into the history by the next victim search
+  hits.record(frame);
+}
+
+void LruKPolicy::pageRemoved(const FrameId frame)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  hits.take(frame);
+  if (resident[frame])
+  {
+    // the file may be closed for good, so its history is not retained
+    order.erase(orderKey(frame));
+    resident[frame] = false;
+  }
+  freeFrames.insert(frame);
+}
+
+bool LruKPolicy::pickVictim(FrameId& frame, const FrameFilter& evictable)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  foldHits();
+  for (std::set<FrameId>::iterator it = freeFrames.begin(); it != freeFrames.end(); ++it)
+  {
+    if (evictable(*it))
+    {
+      frame = *it;
+      return true;
+    }
+  }
+
+  for (std::set<OrderKey>::iterator it = order.begin(); it != order.end(); ++it)
+  {
+    if (evictable(it->second))
+    {
+      frame = it->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void LruKPolicy::upcomingVictims(const std::uint32_t count, const FrameFilter& evictable,
+                                 std::vector<FrameId>& frames)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  foldHits();
+  for (std::set<OrderKey>::iterator it = order.begin(); it != order.end() && frames.size() < count; ++it)
+  {
+    if (evictable(it->second))
+      frames.push_back(it->second);
+  }
+}
+
+void LruKPolicy::resize(const std::uint32_t frames)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  for (FrameId i = numFrames; i < frames; i++)
+    freeFrames.insert(i);
+  for (FrameId i = frames; i < numFrames; i++)
+    freeFrames.erase(i);
+  numFrames = frames;
+  maxRetained = frames;
+}
+
+void LruKPolicy::fileFlushed(const File* file)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  // another file may be opened at the same address; it must not inherit these histories
+  RetainedMap::iterator it = retained.lower_bound(PageKey(file, 0));
+  while (it != retained.end() && it->first.first == file)
+  {
+    retainedOrder.erase(it->second.second);
+    retained.erase(it++);
+  }
+}
+
+//----------------------------------------
+// 2Q
+//----------------------------------------
+
+TwoQPolicy::TwoQPolicy(const std::uint32_t numFrames, const std::uint32_t maxFrames)
+  : hits(maxFrames), numFrames(numFrames), keys(maxFrames), queue(maxFrames, NONE), position(maxFrames)
+{
+  setQueueSizes();
+
+  for (FrameId i = 0; i < numFrames; i++)
+  {
+    queue[i] = FREE;
+    position[i] = freeFrames.insert(freeFrames.end(), i);
+  }
+}
+
+void TwoQPolicy::setQueueSizes()
+{
+  // the sizes recommended by the paper: Kin = 25%, Kout = 50% of the pool
+  kin = numFrames / 4 > 0 ? numFrames / 4 : 1;
+  kout = numFrames / 2 > 0 ? numFrames / 2 : 1;
+}
+
+void TwoQPolicy::unlink(const FrameId frame)
+{
+  switch (queue[frame])
+  {
+    case FREE:
+      freeFrames.erase(position[frame]);
+      break;
+    case A1IN:
+      a1in.erase(position[frame]);
+      break;
+    case AM:
+      am.erase(position[frame]);
+      break;
+    case NONE:
+      break;
+  }
+}
+
+void TwoQPolicy::foldHits()
+{
+  std::vector<std::pair<std::uint64_t, FrameId> > pending;
+  hits.drain(numFrames, pending);
+  // hits in A1in are correlated references and do not promote the page
+  for (std::size_t i = 0; i < pending.size(); i++)
+  {
+    if (queue[pending[i].second] == AM)
+      am.splice(am.end(), am, position[pending[i].second]);
+  }
+}
+
+void TwoQPolicy::pageLoaded(const FrameId frame, const File* file, const PageId pageNo)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  hits.take(frame);
+
+  // a page pushed out of A1in is remembered in A1out
+  if (queue[frame] == A1IN)
+  {
+    a1outIndex[keys[frame]] = a1out.insert(a1out.end(), keys[frame]);
+    if (a1out.size() > kout)
+    {
+      a1outIndex.erase(a1out.front());
+      a1out.pop_front();
+    }
+  }
+  unlink(frame);
+
+  keys[frame] = PageKey(file, pageNo);
+  std::map<PageKey, std::list<PageKey>::iterator>::iterator ghost = a1outIndex.find(keys[frame]);
+  if (ghost != a1outIndex.end())
+  {
+    // referenced again shortly after leaving A1in: a hot page
+    a1out.erase(ghost->second);
+    a1outIndex.erase(ghost);
+    queue[frame] = AM;
+    position[frame] = am.insert(am.end(), frame);
+  }
+  else
+  {
+    queue[frame] = A1IN;
+    position[frame] = a1in.insert(a1in.end(), frame);
+  }
+}
+
+void TwoQPolicy::pageAccessed(const FrameId frame)
+{
+  // applied by the next victim search
+  hits.record(frame);
+}
+
+void TwoQPolicy::pageRemoved(const FrameId frame)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  hits.take(frame);
+  unlink(frame);
+  queue[frame] = FREE;
+  position[frame] = freeFrames.insert(freeFrames.end(), frame);
+}
+
+bool TwoQPolicy::pickFrom(std::list<FrameId>& frames, FrameId& frame, const FrameFilter& evictable)
+{
+  for (std::list<FrameId>::iterator it = frames.begin(); it != frames.end(); ++it)
+  {
+    if (evictable(*it))
+    {
+      frame = *it;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TwoQPolicy::pickVictim(FrameId& frame, const FrameFilter& evictable)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  foldHits();
+  if (pickFrom(freeFrames, frame, evictable))
+    return true;
+
+  if (a1in.size() > kin)
+    return pickFrom(a1in, frame, evictable) || pickFrom(am, frame, evictable);
+  return pickFrom(am, frame, evictable) || pickFrom(a1in, frame, evictable);
+}
+
+void TwoQPolicy::listFrom(const std::list<FrameId>& frames, const std::uint32_t count,
+                          const FrameFilter& evictable, std::vector<FrameId>& out)
+{
+  for (std::list<FrameId>::const_iterator it = frames.begin(); it != frames.end() && out.size() < count; ++it)
+  {
+    if (evictable(*it))
+      out.push_back(*it);
+  }
+}
+
+void TwoQPolicy::upcomingVictims(const std::uint32_t count, const FrameFilter& evictable,
+                                 std::vector<FrameId>& frames)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  foldHits();
+  if (a1in.size() > kin)
+  {
+    listFrom(a1in, count, evictable, frames);
+    listFrom(am, count, evictable, frames);
+  }
+  else
+  {
+    listFrom(am, count, evictable, frames);
+    listFrom(a1in, count, evictable, frames);
+  }
+}
+
+void TwoQPolicy::resize(const std::uint32_t frames)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  for (FrameId i = numFrames; i < frames; i++)
+  {
+    queue[i] = FREE;
+    position[i] = freeFrames.insert(freeFrames.end(), i);
+  }
+  for (FrameId i = frames; i < numFrames; i++)
+  {
+    unlink(i);
+    queue[i] = NONE;
+  }
+  numFrames = frames;
+  setQueueSizes();
+}
+
+void TwoQPolicy::fileFlushed(const File* file)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  // another file may be opened at the same address; its pages must not pass for hot
+  std::map<PageKey, std::list<PageKey>::iterator>::iterator it = a1outIndex.lower_bound(PageKey(file, 0));
+  while (it != a1outIndex.end() && it->first.first == file)
+  {
+    a1out.erase(it->second);
+    a1outIndex.erase(it++);
+  }
+}
+
+}
@@ -0,0 +1,485 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "file.h"
+#include "frame_state.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Page replacement policies a BufMgr can be constructed with.
+ *
+ * None of them takes a lock on a hit.  LRU_K and TWO_Q keep a global order of
+ * the pages, which they only bring up to date with the hits recorded since
+ * when a victim is picked, under a policy-wide mutex; CLOCK needs no mutex at
+ * all, so it still scales best when misses are frequent.
+ */
+enum ReplacementPolicyType
+{
+	CLOCK = 0,
+	LRU_K = 1,
+	TWO_Q = 2
+};
+
+/**
+ * @brief Strategy deciding which buffer pool frame is given up when a new page needs one.
+ *
+ * BufMgr reports every page it places in a frame, every hit on a resident
+ * page and every frame it empties without going through pickVictim().  When
+ * it needs a frame, it asks for a victim, which it then tries to evict; a
+ * frame may become pinned in between, in which case it asks again.
+ *
+ * Implementations must be threadsafe: all methods may be called concurrently
+ * by the threads sharing the buffer pool.
+ */
+class ReplacementPolicy
+{
+ public:
+	/**
+	 * Predicate telling the policy whether a frame may currently be evicted.
+	 */
+	typedef std::function<bool(FrameId)> FrameFilter;
+
+	/**
+	 * Creates a policy of the given type for a pool of numFrames frames.
+	 *
+	 * @param type       Policy to create
+	 * @param numFrames  Number of frames in the buffer pool
+	 * @param maxFrames  Number of frames the pool may be resized to at most
+	 * @return  Newly allocated policy; the caller owns it.
+	 */
+	static ReplacementPolicy* create(const ReplacementPolicyType type, const std::uint32_t numFrames,
+	                                 const std::uint32_t maxFrames);
+
+	virtual ~ReplacementPolicy() {}
+
+	/**
+	 * Called after a page has been placed in a frame (read or newly allocated).
+	 *
+	 * @param frame   Frame now holding the page
+	 * @param file    File of the page
+	 * @param pageNo  Page number in the file
+	 */
+	virtual void pageLoaded(const FrameId frame, const File* file, const PageId pageNo) = 0;
+
+	/**
+	 * Called on every buffer pool hit.
+	 *
+	 * @param frame   Frame of the page accessed
+	 */
+	virtual void pageAccessed(const FrameId frame) = 0;
+
+	/**
+	 * Called when a frame has been emptied other than by evicting it for a new page,
+	 * e.g. by flushFile() or disposePage(), or after a failed read.
+	 *
+	 * @param frame   Frame no longer holding a page
+	 */
+	virtual void pageRemoved(const FrameId frame) = 0;
+
+	/**
+	 * Proposes the frame to evict next.
+	 *
+	 * @param frame      Victim frame returned via this variable
+	 * @param evictable  Predicate telling whether a frame is currently evictable
+	 * @return  False if no evictable frame was found.
+	 */
+	virtual bool pickVictim(FrameId& frame, const FrameFilter& evictable) = 0;
+
+	/**
+	 * Lists the evictable frames the policy expects to pick next, in that order, without changing its state.
+	 * Used by the background writer to clean pages before they are needed.
+	 *
+	 * @param count      Most frames to list
+	 * @param evictable  Predicate telling whether a frame is currently evictable
+	 * @param frames     Frames are appended to this vector
+	 */
+	virtual void upcomingVictims(const std::uint32_t count, const FrameFilter& evictable,
+	                             std::vector<FrameId>& frames) = 0;
+
+	/**
+	 * Called when the buffer pool has been resized.  New frames are empty; frames beyond the new size
+	 * have been emptied (pageRemoved()) before the pool shrinks, and must not be proposed any more.
+	 *
+	 * @param numFrames  New number of frames, at most the maximum given at creation
+	 */
+	virtual void resize(const std::uint32_t numFrames) = 0;
+
+	/**
+	 * Called when every page of a file has been flushed from the pool, as the file may then be closed and another
+	 * one opened at its address.  Policies remembering evicted pages forget those of the file.
+	 *
+	 * @param file    File flushed
+	 */
+	virtual void fileFlushed(const File* file) {}
+
+	/**
+	 * Returns the name of the policy, for reporting.
+	 */
+	virtual const char* name() const = 0;
+};
+
+/**
+ * @brief The clock (second chance) algorithm.
+ *
+ * Reference bits are kept in a FrameBitset and the hand is moved with a
+ * compare-and-swap, so neither hits nor victim searches take a lock.  The
+ * sweep looks at the reference bits of up to a word of frames at once and
+ * only asks about the frames whose bit is clear.
+ */
+class ClockPolicy : public ReplacementPolicy
+{
+ public:
+	ClockPolicy(const std::uint32_t numFrames, const std::uint32_t maxFrames);
+	~ClockPolicy();
+
+	void pageLoaded(const FrameId frame, const File* file, const PageId pageNo);
+	void pageAccessed(const FrameId frame);
+	void pageRemoved(const FrameId frame);
+	bool pickVictim(FrameId& frame, const FrameFilter& evictable);
+	void upcomingVictims(const std::uint32_t count, const FrameFilter& evictable,
+	                     std::vector<FrameId>& frames);
+	void resize(const std::uint32_t numFrames);
+	const char* name() const { return "clock"; }
+
+ private:
+	/**
+	 * Number of frames in the buffer pool
+	 */
+	std::atomic<std::uint32_t> numFrames;
+
+	/**
+	 * Current position of clockhand in our buffer pool
+	 */
+	std::atomic<FrameId> clockHand;
+
+	/**
+	 * Has this buffer frame been reference recently
+	 */
+	FrameBitset refbits;
+};
+
+/**
+ * @brief Hits on frames recorded without a lock, for a policy to fold into its order later.
+ *
+ * A hit stores a time stamp from a shared atomic clock in the frame's slot
+ * and marks the frame in a FrameBitset; only the latest hit on a frame since
+ * the last fold is kept.  take() and drain() hand the stamps over and clear
+ * them, so a hit is folded in once however it races with them.
+ */
+class PendingHits
+{
+ public:
+	/**
+	 * @param maxFrames  Number of frames the pool may be resized to at most
+	 */
+	explicit PendingHits(const std::uint32_t maxFrames);
+	~PendingHits();
+
+	/**
+	 * Advances the clock and returns the new time.
+	 */
+	std::uint64_t tick()
+	{
+		return ++clock;
+	}
+
+	/**
+	 * Records a hit on a frame.
+	 */
+	void record(const FrameId frame)
+	{
+		stamps[frame] = tick();
+		if (!frames.test(frame))
+			frames.set(frame);
+	}
+
+	/**
+	 * Returns the time of the pending hit on a frame, 0 if there is none, and clears it.
+	 */
+	std::uint64_t take(const FrameId frame)
+	{
+		return stamps[frame].exchange(0);
+	}
+
+	/**
+	 * Takes the pending hits on the first numFrames frames, as (time, frame), oldest first.
+	 *
+	 * @param numFrames  Number of frames in the buffer pool
+	 * @param hits       Hits are appended to this vector
+	 */
+	void drain(const std::uint32_t numFrames, std::vector<std::pair<std::uint64_t, FrameId> >& hits);
+
+ private:
+	/**
+	 * Logical time, advanced on every hit and by tick()
+	 */
+	std::atomic<std::uint64_t> clock;
+
+	/**
+	 * Per frame: time of the pending hit, 0 if there is none
+	 */
+	std::atomic<std::uint64_t>* stamps;
+
+	/**
+	 * Frames which may have a pending hit
+	 */
+	FrameBitset frames;
+
+	/**
+	 * Number of entries of stamps
+	 */
+	std::uint32_t maxFrames;
+
+	// Not copyable; the slots are shared with the threads recording hits.
+	PendingHits(const PendingHits&);
+	PendingHits& operator=(const PendingHits&);
+};
+
+/**
+ * @brief The LRU-K algorithm (O'Neil, O'Neil and Weikum), with K = 2.
+ *
+ * The victim is the evictable page whose K-th most recent reference lies
+ * furthest in the past; pages referenced fewer than K times go first, in LRU
+ * order.  Reference history of evicted pages is retained for a while, so a
+ * page that comes back soon is not treated as cold.
+ *
+ * pageAccessed() only records the hit in PendingHits; the other methods take
+ * the policy's latch, and pickVictim() and upcomingVictims() first shift the
+ * recorded hits into the histories.  Several hits on a page between two folds
+ * count as its latest one.  The histories of a file's evicted pages are
+ * dropped when it is flushed.
+ */
+class LruKPolicy : public ReplacementPolicy
+{
+ public:
+	/**
+	 * Number of past references remembered per page.
+	 */
+	static const int K = 2;
+
+	LruKPolicy(const std::uint32_t numFrames, const std::uint32_t maxFrames);
+
+	void pageLoaded(const FrameId frame, const File* file, const PageId pageNo);
+	void pageAccessed(const FrameId frame);
+	void pageRemoved(const FrameId frame);
+	bool pickVictim(FrameId& frame, const FrameFilter& evictable);
+	void upcomingVictims(const std::uint32_t count, const FrameFilter& evictable,
+	                     std::vector<FrameId>& frames);
+	void resize(const std::uint32_t numFrames);
+	void fileFlushed(const File* file);
+	const char* name() const { return "lru-k"; }
+
+ private:
+	typedef std::pair<const File*, PageId> PageKey;
+
+	/**
+	 * @brief Reference history of one page, most recent reference first
+	 */
+	struct History {
+		std::uint64_t times[K];
+	};
+
+	typedef std::map<PageKey, std::pair<History, std::list<PageKey>::iterator> > RetainedMap;
+
+	/**
+	 * Eviction order key: K-th most recent reference, most recent reference, frame
+	 */
+	typedef std::pair<std::pair<std::uint64_t, std::uint64_t>, FrameId> OrderKey;
+
+	/**
+	 * Returns the position of a resident frame in the eviction order.
+	 */
+	OrderKey orderKey(const FrameId frame) const;
+
+	/**
+	 * Takes a resident frame out of the eviction order, retaining its history.
+	 */
+	void retire(const FrameId frame);
+
+	/**
+	 * Shifts a hit at the given time into the history of a resident frame, moving it in the eviction order.
+	 */
+	void applyHit(const FrameId frame, const std::uint64_t time);
+
+	/**
+	 * Applies the hits recorded since the last call.
+	 */
+	void foldHits();
+
+	/**
+	 * Hits not yet applied; also the clock of the histories
+	 */
+	PendingHits hits;
+
+	/**
+	 * Protects all members below
+	 */
+	std::mutex latch;
+
+	/**
+	 * Number of frames in the buffer pool
+	 */
+	std::uint32_t numFrames;
+
+	/**
+	 * Per frame: page held, whether it holds one, and its history
+	 */
+	std::vector<PageKey> keys;
+	std::vector<bool> resident;
+	std::vector<History> history;
+
+	/**
+	 * Frames holding no page
+	 */
+	std::set<FrameId> freeFrames;
+
+	/**
+	 * Resident frames in eviction order
+	 */
+	std::set<OrderKey> order;
+
+	/**
+	 * Retained history of recently evicted pages, with their position in retainedOrder
+	 */
+	RetainedMap retained;
+
+	/**
+	 * Pages with retained history, oldest first
+	 */
+	std::list<PageKey> retainedOrder;
+
+	/**
+	 * Most histories retained for pages not in the pool
+	 */
+	std::uint32_t maxRetained;
+};
+
+/**
+ * @brief The full 2Q algorithm (Johnson and Shasha).
+ *
+ * Pages referenced once live in a FIFO queue (A1in).  Pages evicted from it
+ * are remembered in a ghost queue (A1out); a page that is read again while
+ * remembered there is considered hot and enters the LRU queue (Am).  Large
+ * scans therefore only cycle through A1in and leave Am alone.
+ *
+ * pageAccessed() only records the hit in PendingHits; the other methods take
+ * the policy's latch, and pickVictim() and upcomingVictims() first move the
+ * pages of Am hit since, in the order of their latest hits, to the end of the
+ * queue.  The ghosts of a file's pages are dropped when it is flushed.
+ */
+class TwoQPolicy : public ReplacementPolicy
+{
+ public:
+	TwoQPolicy(const std::uint32_t numFrames, const std::uint32_t maxFrames);
+
+	void pageLoaded(const FrameId frame, const File* file, const PageId pageNo);
+	void pageAccessed(const FrameId frame);
+	void pageRemoved(const FrameId frame);
+	bool pickVictim(FrameId& frame, const FrameFilter& evictable);
+	void upcomingVictims(const std::uint32_t count, const FrameFilter& evictable,
+	                     std::vector<FrameId>& frames);
+	void resize(const std::uint32_t numFrames);
+	void fileFlushed(const File* file);
+	const char* name() const { return "2q"; }
+
+ private:
+	typedef std::pair<const File*, PageId> PageKey;
+
+	/**
+	 * Queue a frame currently belongs to; NONE for frames beyond the current pool size
+	 */
+	enum Queue { FREE, A1IN, AM, NONE };
+
+	/**
+	 * Sets Kin and Kout for the pool size.
+	 */
+	void setQueueSizes();
+
+	/**
+	 * Removes a frame from the queue it is on.
+	 */
+	void unlink(const FrameId frame);
+
+	/**
+	 * Moves the frames of Am hit since the last call to its end, in the order of their latest hits.
+	 */
+	void foldHits();
+
+	/**
+	 * Returns the first evictable frame of the given queue, if any.
+	 */
+	bool pickFrom(std::list<FrameId>& frames, FrameId& frame, const FrameFilter& evictable);
+
+	/**
+	 * Appends evictable frames of the given queue, in order, until out holds count entries.
+	 */
+	void listFrom(const std::list<FrameId>& frames, const std::uint32_t count,
+	              const FrameFilter& evictable, std::vector<FrameId>& out);
+
+	/**
+	 * Hits not yet applied
+	 */
+	PendingHits hits;
+
+	/**
+	 * Protects all members below
+	 */
+	std::mutex latch;
+
+	/**
+	 * Number of frames in the buffer pool
+	 */
+	std::uint32_t numFrames;
+
+	/**
+	 * Target size of A1in and maximum size of A1out
+	 */
+	std::uint32_t kin;
+	std::uint32_t kout;
+
+	/**
+	 * Per frame: page held, queue and position in it
+	 */
+	std::vector<PageKey> keys;
+	std::vector<Queue> queue;
+	std::vector<std::list<FrameId>::iterator> position;
+
+	/**
+	 * Frames holding no page
+	 */
+	std::list<FrameId> freeFrames;
+
+	/**
+	 * FIFO of pages referenced once, oldest first
+	 */
+	std::list<FrameId> a1in;
+
+	/**
+	 * LRU queue of hot pages, least recently used first
+	 */
+	std::list<FrameId> am;
+
+	/**
+	 * Ghost queue of pages recently evicted from A1in, oldest first
+	 */
+	std::list<PageKey> a1out;
+	std::map<PageKey, std::list<PageKey>::iterator> a1outIndex;
+};
+
+}
@@ -0,0 +1,451 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "wal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <set>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "exceptions/file_io_exception.h"
+#include "exceptions/invalid_page_exception.h"
+
+namespace badgerdb {
+
+static const std::uint32_t LOG_MAGIC = 0x4c415742;  // "BWAL"
+
+// longest file name a record may hold; anything longer is taken for a torn record
+static const std::uint32_t MAX_NAME_LENGTH = 4096;
+
+namespace {
+
+/**
+ * Reads size bytes at the given position of a descriptor.
+ *
+ * @return  0, or an errno value; EIO if the end of the file comes first.
+ */
+int readFully(const int fd, void* data, std::size_t size, off_t position)
+{
+  char* next = static_cast<char*>(data);
+  while (size > 0)
+  {
+    const ssize_t done = pread(fd, next, size, position);
+    if (done < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    if (done == 0)
+      return EIO;
+    next += done;
+    size -= done;
+    position += done;
+  }
+  return 0;
+}
+
+/**
+ * Writes size bytes at the given position of a descriptor.
+ *
+ * @return  0, or an errno value.
+ */
+int writeFully(const int fd, const void* data, std::size_t size, off_t position)
+{
+  const char* next = static_cast<const char*>(data);
+  while (size > 0)
+  {
+    const ssize_t done = pwrite(fd, next, size, position);
+    if (done < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    next += done;
+    size -= done;
+    position += done;
+  }
+  return 0;
+}
+
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& filename)
+  : filename_(filename), fd(-1), baseLsn(0), bufferLsn(0), durable(0), flushing(false)
+{
+  fd = ::open(filename_.c_str(), O_RDWR | O_CREAT, 0666);
+  if (fd < 0)
+    throw FileIOException(filename_, "open", errno);
+
+  struct stat status;
+  if (fstat(fd, &status) != 0)
+  {
+    const int error = errno;
+    ::close(fd);
+    throw FileIOException(filename_, "stat", error);
+  }
+
+  Lsn end = 0;
+  try
+  {
+    if ((std::size_t) status.st_size < sizeof(LogFileHeader))
+    {
+      // a new log, or one that crashed while it was being created
+      writeFileHeader(fd, baseLsn);
+    }
+    else
+    {
+      LogFileHeader header;
+      const int error = readFully(fd, &header, sizeof(header), 0);
+      if (error != 0)
+        throw FileIOException(filename_, "read", error);
+      if (header.magic != LOG_MAGIC || header.pageSize != Page::SIZE)
+        throw FileIOException(filename_, "read", EINVAL);
+      baseLsn = header.baseLsn;
+
+      // find the end of the intact records
+      const Lsn fileEnd = baseLsn + (status.st_size - sizeof(LogFileHeader));
+      RecordHeader record;
+      std::string name;
+      Page page;
+      end = baseLsn;
+      while (readRecord(end, fileEnd, record, name, page))
+        end += recordSize(record.nameLength);
+    }
+
+    // cut off a torn tail, so no stale record ever follows the ones appended next
+    if (ftruncate(fd, position(end)) != 0 || fdatasync(fd) != 0)
+      throw FileIOException(filename_, "truncate", errno);
+  }
+  catch (...)
+  {
+    ::close(fd);
+    throw;
+  }
+  bufferLsn = durable = end;
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+  try
+  {
+    flush(endLsn());
+  }
+  catch (...)
+  {
+    // the records are lost, as they would be in a crash
+  }
+  ::close(fd);
+}
+
+std::uint32_t WriteAheadLog::checksum(const char* record, const std::size_t size)
+{
+  // FNV-1a
+  std::uint32_t hash = 2166136261u;
+  for (std::size_t i = 0; i < size; i++)
+  {
+    hash ^= (unsigned char) record[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+Lsn WriteAheadLog::logPage(const File* file, const PageId pageNo, const Page& page)
+{
+  const std::string& name = file->filename();
+  const std::size_t size = recordSize(name.size());
+
+  std::lock_guard<std::mutex> guard(latch);
+  std::size_t offset;
+  const std::pair<std::string, PageId> key(name, pageNo);
+  std::map<std::pair<std::string, PageId>, std::size_t>::const_iterator entry = buffered.find(key);
+  if (entry != buffered.end())
+  {
+    // the last record of the page is not written yet; replace its image
+    offset = entry->second;
+  }
+  else
+  {
+    offset = buffer.size();
+    buffer.resize(offset + size);
+    buffered[key] = offset;
+  }
+
+  char* record = &buffer[offset];
+  RecordHeader header = {0, pageNo, (std::uint32_t) name.size(), 0};
+  std::memcpy(record, &header, sizeof(header));
+  std::memcpy(record + sizeof(header), name.data(), name.size());
+  std::memcpy(record + sizeof(header) + name.size(), &page, Page::SIZE);
+  header.checksum = checksum(record + sizeof(header.checksum), size - sizeof(header.checksum));
+  std::memcpy(record, &header.checksum, sizeof(header.checksum));
+  return bufferLsn + offset + size;
+}
+
+bool WriteAheadLog::flush(const Lsn lsn)
+{
+  std::unique_lock<std::mutex> lock(latch);
+  bool wrote = false;
+  while (true)
+  {
+    // nothing past the records logged so far can be made durable
+    const Lsn target = std::min(lsn, bufferLsn + buffer.size());
+    if (durable >= target)
+      return wrote;
+    if (flushing)
+    {
+      // the records are written by the thread flushing now, or by the next one together with ours
+      flushed.wait(lock);
+      continue;
+    }
+
+    std::string batch;
+    batch.swap(buffer);
+    buffered.clear();
+    const Lsn start = bufferLsn;
+    bufferLsn += batch.size();
+    flushing = true;
+    lock.unlock();
+
+    int error = writeFully(fd, batch.data(), batch.size(), position(start));
+    if (error == 0 && fdatasync(fd) != 0)
+      error = errno;
+
+    lock.lock();
+    flushing = false;
+    if (error != 0)
+    {
+      // keep the records for the next flush
+      batch.append(buffer);
+      buffer.swap(batch);
+      bufferLsn = start;
+      flushed.notify_all();
+      throw FileIOException(filename_, "write", error);
+    }
+    durable = start + batch.size();
+    wrote = true;
+    flushed.notify_all();
+  }
+}
+
+Lsn WriteAheadLog::endLsn()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return bufferLsn + buffer.size();
+}
+
+Lsn WriteAheadLog::durableLsn()
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return durable;
+}
+
+bool WriteAheadLog::readRecord(const Lsn lsn, const Lsn end, RecordHeader& header, std::string& name,
+                               Page& page) const
+{
+  if (end - lsn < sizeof(RecordHeader))
+    return false;
+  if (readFully(fd, &header, sizeof(header), position(lsn)) != 0)
+    return false;
+  if (header.nameLength > MAX_NAME_LENGTH || end - lsn < recordSize(header.nameLength))
+    return false;
+
+  std::string record(recordSize(header.nameLength), '\0');
+  if (readFully(fd, &record[0], record.size(), position(lsn)) != 0)
+    return false;
+  if (checksum(&record[sizeof(header.checksum)], record.size() - sizeof(header.checksum)) != header.checksum)
+    return false;
+
+  name.assign(record, sizeof(header), header.nameLength);
+  std::memcpy(&page, &record[sizeof(header) + header.nameLength], Page::SIZE);
+  return true;
+}
+
+std::uint32_t WriteAheadLog::redo(const std::vector<File*>& files)
+{
+  std::map<std::string, File*> byName;
+  for (std::size_t i = 0; i < files.size(); i++)
+    byName[files[i]->filename()] = files[i];
+
+  Lsn lsn;
+  Lsn end;
+  {
+    std::lock_guard<std::mutex> guard(latch);
+    lsn = baseLsn;
+    end = durable;
+  }
+
+  std::set<File*> written;
+  std::uint32_t applied = 0;
+  bool others = false;
+  RecordHeader header;
+  std::string name;
+  Page page;
+  for (; lsn < end && readRecord(lsn, end, header, name, page); lsn += recordSize(header.nameLength))
+  {
+    std::map<std::string, File*>::const_iterator file = byName.find(name);
+    if (file == byName.end())
+    {
+      others = true;
+      continue;
+    }
+
+    try
+    {
+      file->second->writePage(header.pageNo, page);
+    }
+    catch (InvalidPageException&)
+    {
+      // the page has been deleted since
+      continue;
+    }
+    written.insert(file->second);
+    applied++;
+  }
+
+  for (std::set<File*>::const_iterator it = written.begin(); it != written.end(); ++it)
+    (*it)->sync();
+
+  if (!others)
+    truncate();
+  return applied;
+}
+
+void WriteAheadLog::truncate()
+{
+  std::unique_lock<std::mutex> lock(latch);
+  while (flushing)
+    flushed.wait(lock);
+
+  baseLsn = bufferLsn + buffer.size();
+  buffer.clear();
+  buffered.clear();
+  bufferLsn = durable = baseLsn;
+
+  // drop the records before the header moves the base past them
+  if (ftruncate(fd, sizeof(LogFileHeader)) != 0)
+    throw FileIOException(filename_, "truncate", errno);
+  writeFileHeader(fd, baseLsn);
+  if (fdatasync(fd) != 0)
+    throw FileIOException(filename_, "sync", errno);
+}
+
+Lsn WriteAheadLog::discardBefore(const Lsn lsn)
+{
+  std::unique_lock<std::mutex> lock(latch);
+  while (flushing)
+    flushed.wait(lock);
+
+  // keep flushes and truncate() off the log file while the records are copied; logging goes on
+  const Lsn end = durable;
+  const Lsn base = baseLsn;
+  flushing = true;
+  lock.unlock();
+
+  int error = 0;
+  const char* operation = "read";
+  const std::string tempname = filename_ + ".tmp";
+  int target = -1;
+
+  // find the first record still needed
+  Lsn keep = base;
+  while (keep < end)
+  {
+    RecordHeader header;
+    error = readFully(fd, &header, sizeof(header), position(keep));
+    if (error != 0 || keep + recordSize(header.nameLength) > lsn)
+      break;
+    keep += recordSize(header.nameLength);
+  }
+
+  if (error == 0 && keep > base)
+  {
+    operation = "write";
+    target = ::open(tempname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (target < 0)
+      error = errno;
+
+    std::string chunk;
+    const std::size_t CHUNK_SIZE = 1 << 20;
+    for (Lsn next = keep; error == 0 && next < end; next += chunk.size())
+    {
+      chunk.resize((std::size_t) std::min<Lsn>(CHUNK_SIZE, end - next));
+      error = readFully(fd, &chunk[0], chunk.size(), position(next));
+      if (error == 0)
+        error = writeFully(target, chunk.data(), chunk.size(), sizeof(LogFileHeader) + (next - keep));
+    }
+    if (error == 0)
+    {
+      try
+      {
+        writeFileHeader(target, keep);
+      }
+      catch (FileIOException& e)
+      {
+        error = e.error();
+      }
+    }
+    if (error == 0 && fdatasync(target) != 0)
+      error = errno;
+    if (error == 0 && std::rename(tempname.c_str(), filename_.c_str()) != 0)
+      error = errno;
+
+    // make the rename itself durable
+    if (error == 0)
+    {
+      const std::string::size_type slash = filename_.rfind('/');
+      const std::string directory = slash == std::string::npos ? "." : filename_.substr(0, slash + 1);
+      const int dirFd = ::open(directory.c_str(), O_RDONLY);
+      if (dirFd >= 0)
+      {
+        fsync(dirFd);
+        ::close(dirFd);
+      }
+    }
+  }
+
+  lock.lock();
+  if (error == 0 && keep > base)
+  {
+    ::close(fd);
+    fd = target;
+    baseLsn = keep;
+  }
+  else
+  {
+    keep = base;
+    if (target >= 0)
+    {
+      ::close(target);
+      unlink(tempname.c_str());
+    }
+  }
+  flushing = false;
+  flushed.notify_all();
+  if (error != 0)
+    throw FileIOException(filename_, operation, error);
+  return keep;
+}
+
+void WriteAheadLog::writeFileHeader(const int target, const Lsn base)
+{
+  LogFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = LOG_MAGIC;
+  header.pageSize = Page::SIZE;
+  header.baseLsn = base;
+  const int error = writeFully(target, &header, sizeof(header), 0);
+  if (error != 0)
+    throw FileIOException(filename_, "write", error);
+}
+
+}
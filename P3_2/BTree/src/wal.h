@@ -0,0 +1,250 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Log sequence number: the position in a write-ahead log just past a record.
+ */
+typedef std::uint64_t Lsn;
+
+/**
+ * @brief Write-ahead log of page images, with group commit and redo recovery.
+ *
+ * BufMgr logs the image of a page each time the page is unpinned dirty, and
+ * flushes the log up to the page's last record before it writes the page to
+ * its file, so a file never holds a page state the log could lose.  Records
+ * are kept in memory until flush().  While one thread writes and syncs the
+ * log, threads flushing meanwhile wait, and the next of them writes all of
+ * their records with a single sync (group commit).  A page logged again
+ * before its record has been written replaces that record instead of adding
+ * another.
+ *
+ * A record holds the name of the file, the page number, the full image of the
+ * page and a checksum.  redo() writes the images back to their files in log
+ * order and stops at the first torn record at the end of the log; images are
+ * whole pages, so replaying a record twice does no harm.
+ *
+ * LSNs count the bytes of records logged since the log was created, and keep
+ * growing when the log is truncated.  LSN 0 comes before every record.  The
+ * log file header holds the LSN of the first record kept; a checkpoint moves
+ * it forward with discardBefore(), which bounds the work of redo().
+ *
+ * All methods are threadsafe.
+ */
+class WriteAheadLog
+{
+ public:
+	/**
+	 * Opens the log in the named file, creating it if it does not exist.  A torn record at the end of the log,
+	 * left by a crash during a flush, is cut off.
+	 *
+	 * @param filename	Name of the log file
+	 * @throws  FileIOException  If the log cannot be opened or read.
+	 */
+	explicit WriteAheadLog(const std::string& filename);
+
+	/**
+	 * Flushes the records logged so far and closes the log.
+	 */
+	~WriteAheadLog();
+
+	/**
+	 * Returns the name of the log file.
+	 */
+	const std::string& filename() const
+	{
+		return filename_;
+	}
+
+	/**
+	 * Logs the image of a page.  The record is only durable once the log is flushed past the returned LSN.
+	 *
+	 * @param file   	File the page belongs to
+	 * @param pageNo 	Number of the page
+	 * @param page   	Image of the page
+	 * @return  LSN the log must be flushed to before the page may be written to its file.
+	 */
+	Lsn logPage(const File* file, const PageId pageNo, const Page& page);
+
+	/**
+	 * Writes and syncs the log up to at least the given LSN, together with every other record logged by then.
+	 *
+	 * @param lsn    	LSN to make durable
+	 * @return  True if this call wrote the log, false if the records were already durable or were written by
+	 *          another thread.
+	 * @throws  FileIOException  If the log cannot be written.
+	 */
+	bool flush(const Lsn lsn);
+
+	/**
+	 * Returns the LSN of the end of the records logged so far.
+	 */
+	Lsn endLsn();
+
+	/**
+	 * Returns the LSN up to which the log is durable.
+	 */
+	Lsn durableLsn();
+
+	/**
+	 * Writes the page images in the log back to the given files, in log order, and syncs the files.  Records of
+	 * pages deleted since they were logged are passed over.  If every record belongs to one of the files, the log
+	 * is truncated afterwards; otherwise the records are kept for a later redo() with the other files.
+	 * Call this before any page of the files is read into a buffer pool.
+	 *
+	 * @param files  	Files to recover, found by name
+	 * @return  Number of page images written back.
+	 * @throws  FileIOException  If the log cannot be read or a file cannot be written.
+	 */
+	std::uint32_t redo(const std::vector<File*>& files);
+
+	/**
+	 * Drops every record, including those not flushed yet.  Only call this once every page logged so far has
+	 * been written to its file and the file synced.
+	 *
+	 * @throws  FileIOException  If the log cannot be truncated.
+	 */
+	void truncate();
+
+	/**
+	 * Drops the durable records which end at or before the given LSN, keeping every later record.  The records
+	 * kept are copied to a new log file which then replaces the old one, so this is cheap as long as few records
+	 * are kept.  Pages may be logged meanwhile; flushes wait until the new file is in place.
+	 *
+	 * @param lsn    	LSN up to which records are no longer needed
+	 * @return  LSN of the first record kept.
+	 * @throws  FileIOException  If the new log file cannot be written.
+	 */
+	Lsn discardBefore(const Lsn lsn);
+
+ private:
+	/**
+	 * @brief First bytes of the log file
+	 */
+	struct LogFileHeader {
+		std::uint32_t magic;
+		std::uint32_t pageSize;
+		/**
+		 * LSN of the first byte after the header
+		 */
+		Lsn baseLsn;
+	};
+
+	/**
+	 * @brief Fixed part of a record, followed by the file name and the page image
+	 */
+	struct RecordHeader {
+		/**
+		 * Checksum of the rest of the record
+		 */
+		std::uint32_t checksum;
+		PageId pageNo;
+		std::uint32_t nameLength;
+		std::uint32_t reserved;
+	};
+
+	/**
+	 * Returns the size of a record for a file name of the given length.
+	 */
+	static std::size_t recordSize(const std::size_t nameLength)
+	{
+		return sizeof(RecordHeader) + nameLength + Page::SIZE;
+	}
+
+	/**
+	 * Returns the checksum of a record laid out in memory.
+	 */
+	static std::uint32_t checksum(const char* record, const std::size_t size);
+
+	/**
+	 * Returns the offset in the log file of the given LSN.
+	 */
+	off_t position(const Lsn lsn) const
+	{
+		return (off_t) (sizeof(LogFileHeader) + (lsn - baseLsn));
+	}
+
+	/**
+	 * Reads the record at the given LSN of the log file.
+	 *
+	 * @param lsn    	LSN the record starts at
+	 * @param end    	LSN of the end of the log file
+	 * @param header 	Fixed part of the record returned via this variable
+	 * @param name   	File name returned via this variable
+	 * @param page   	Page image returned via this variable
+	 * @return  False if there is no complete, intact record at lsn.
+	 */
+	bool readRecord(const Lsn lsn, const Lsn end, RecordHeader& header, std::string& name, Page& page) const;
+
+	/**
+	 * Writes a log file header with the given base LSN to a descriptor.
+	 */
+	void writeFileHeader(const int target, const Lsn base);
+
+	/**
+	 * Name of the log file
+	 */
+	std::string filename_;
+
+	/**
+	 * Descriptor of the log file
+	 */
+	int fd;
+
+	/**
+	 * LSN of the first byte after the log file header
+	 */
+	Lsn baseLsn;
+
+	/**
+	 * Records logged and not yet handed to a flush, and the LSN they start at
+	 */
+	std::string buffer;
+	Lsn bufferLsn;
+
+	/**
+	 * Offset in buffer of the record of each page logged there, by (file name, page number)
+	 */
+	std::map<std::pair<std::string, PageId>, std::size_t> buffered;
+
+	/**
+	 * LSN up to which the log is durable
+	 */
+	Lsn durable;
+
+	/**
+	 * True while a thread writes the log file, by a flush or by discardBefore()
+	 */
+	bool flushing;
+
+	/**
+	 * Protects the members above; flushed is signalled when a flush ends
+	 */
+	std::mutex latch;
+	std::condition_variable flushed;
+
+	// Not copyable; the log file belongs to one object.
+	WriteAheadLog(const WriteAheadLog&);
+	WriteAheadLog& operator=(const WriteAheadLog&);
+};
+
+}